@@ -4,11 +4,14 @@
 ./dip_tool resize data/F16.bmp 512 512 32 32 bilinear
 ./dip_tool resize data/F16.bmp 32 32 512 512 nearest
 ./dip_tool resize data/F16.bmp 32 32 512 512 bilinear
-# ./dip_tool resize out/C/F16_resize_512x512_to_32x32_nearest.png 32 32 512 512 nearest
-# ./dip_tool resize out/C/F16_resize_512x512_to_32x32_bilinear.png 32 32 512 512 bilinear
+./dip_tool resize out/C/F16_resize_512x512_to_32x32_nearest.png 32 32 512 512 nearest
+./dip_tool resize out/C/F16_resize_512x512_to_32x32_bilinear.png 32 32 512 512 bilinear
 ./dip_tool resize data/F16.bmp 512 512 1024 512 nearest
 ./dip_tool resize data/F16.bmp 512 512 1024 512 bilinear
 ./dip_tool resize data/F16.bmp 128 128 256 512 nearest
 ./dip_tool resize data/F16.bmp 128 128 256 512 bilinear
-# ./dip_tool resize out/C/F16_resize_512x512_to_128x128_nearest.png 128 128 256 512 nearest
-# ./dip_tool resize out/C/F16_resize_512x512_to_128x128_bilinear.png 128 128 256 512 bilinear
\ No newline at end of file
+./dip_tool resize out/C/F16_resize_512x512_to_128x128_nearest.png 128 128 256 512 nearest
+./dip_tool resize out/C/F16_resize_512x512_to_128x128_bilinear.png 128 128 256 512 bilinear
+./dip_tool compare data/F16.bmp out/C/F16_resize_512x512_to_32x32_nearest_resize_32x32_to_512x512_nearest.png out/C/F16_resize_512x512_to_32x32_bilinear_resize_32x32_to_512x512_bilinear.png
+./dip_tool compare out/C/F16_resize_512x512_to_256x512_nearest.png out/C/F16_resize_512x512_to_128x128_nearest_resize_128x128_to_256x512_nearest.png
+./dip_tool compare out/C/F16_resize_512x512_to_256x512_bilinear.png out/C/F16_resize_512x512_to_128x128_bilinear_resize_128x128_to_256x512_bilinear.png
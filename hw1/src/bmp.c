@@ -0,0 +1,164 @@
+// Native BMP reader.
+// 只解析檔頭並 mmap 整個檔案；像素列直接指向檔案內容，bottom-up 檔以負的 stride
+// 表示，因此開檔成本只與檔頭有關。需要 Image 時才一次完成翻轉、BGR→RGB 或查色盤。
+
+#define _POSIX_C_SOURCE 200809L
+#include "bmp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static unsigned int le16(const unsigned char *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static unsigned int le32(const unsigned char *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+/** 只接受未壓縮（BI_RGB）的 8-bit 色盤與 24-bit 檔；其他格式回傳 0 交給 stb */
+static int parse_header(const unsigned char *p, size_t len, ImageView *v)
+{
+    if (len < 54 || p[0] != 'B' || p[1] != 'M')
+        return 0;
+    unsigned int offset = le32(p + 10);
+    unsigned int hsz = le32(p + 14);
+    int w = (int)le32(p + 18);
+    int h = (int)le32(p + 22);
+    unsigned int bpp = le16(p + 28);
+    unsigned int compression = le32(p + 30);
+    if (hsz < 40 || compression != 0 || (bpp != 8 && bpp != 24))
+        return 0;
+    if (w <= 0 || h == 0 || h == -2147483647 - 1)
+        return 0;
+    int rows = h < 0 ? -h : h;
+    long row_bytes = ((long)w * (bpp / 8) + 3) & ~3L;
+    if (offset > len || (size_t)row_bytes * rows > len - offset)
+        return 0;
+
+    v->w = w;
+    v->h = rows;
+    v->bpp = (int)(bpp / 8);
+    v->order = ORDER_BGR;
+    v->palette = NULL;
+    v->palette_n = 0;
+    v->gray = 0;
+    if (bpp == 8)
+    {
+        if (offset < 14 + hsz)
+            return 0;
+        int n = (int)((offset - 14 - hsz) / 4);
+        if (n <= 0 || n > 256)
+            return 0;
+        v->palette = p + 14 + hsz;
+        v->palette_n = n;
+        v->gray = n == 256;
+        for (int i = 0; i < n && v->gray; ++i)
+            v->gray = v->palette[4 * i] == i && v->palette[4 * i + 1] == i && v->palette[4 * i + 2] == i;
+    }
+    // 高度為正代表 bottom-up：第一列存在檔案最後
+    const unsigned char *pix = p + offset;
+    if (h > 0)
+    {
+        v->row0 = pix + (size_t)row_bytes * (rows - 1);
+        v->stride = -row_bytes;
+    }
+    else
+    {
+        v->row0 = pix;
+        v->stride = row_bytes;
+    }
+    return 1;
+}
+
+int bmp_open_view(const char *path, ImageView *v)
+{
+    memset(v, 0, sizeof(*v));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    unsigned char magic[2];
+    if (fstat(fd, &st) != 0 || st.st_size < 54 || pread(fd, magic, 2, 0) != 2 || magic[0] != 'B' || magic[1] != 'M')
+    {
+        close(fd);
+        return 0;
+    }
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+    if (!parse_header((const unsigned char *)map, len, v))
+    {
+        munmap(map, len);
+        memset(v, 0, sizeof(*v));
+        return 0;
+    }
+    v->map = map;
+    v->map_len = len;
+    return 1;
+}
+
+int bmp_view_from_memory(const unsigned char *buf, size_t len, ImageView *v)
+{
+    memset(v, 0, sizeof(*v));
+    if (parse_header(buf, len, v))
+        return 1;
+    memset(v, 0, sizeof(*v));
+    return 0;
+}
+
+void bmp_close_view(ImageView *v)
+{
+    if (v->map)
+        munmap(v->map, v->map_len);
+    memset(v, 0, sizeof(*v));
+}
+
+void view_read_rgb(const ImageView *v, int x, int y, int w, int h, unsigned char *dst)
+{
+    for (int j = 0; j < h; ++j)
+    {
+        const unsigned char *src = view_row(v, y + j) + (size_t)x * v->bpp;
+        unsigned char *d = &dst[(size_t)j * w * 3];
+        if (v->bpp == 3)
+        {
+            for (int i = 0; i < w; ++i)
+            {
+                d[3 * i] = src[3 * i + 2];
+                d[3 * i + 1] = src[3 * i + 1];
+                d[3 * i + 2] = src[3 * i];
+            }
+        }
+        else if (v->gray)
+        {
+            for (int i = 0; i < w; ++i)
+                d[3 * i] = d[3 * i + 1] = d[3 * i + 2] = src[i];
+        }
+        else
+        {
+            for (int i = 0; i < w; ++i)
+            {
+                // 超出色盤的索引當作 0（stb 此時讀到的是未初始化的色盤）
+                const unsigned char *e = &v->palette[4 * (src[i] < v->palette_n ? src[i] : 0)];
+                d[3 * i] = e[2];
+                d[3 * i + 1] = e[1];
+                d[3 * i + 2] = e[0];
+            }
+        }
+    }
+}
+
+/** 一次完成翻轉與通道轉換，結果與 stbi_load 相同（8-bit 色盤檔展開為 RGB） */
+Image *image_from_view(const ImageView *v)
+{
+    Image *img = create_image(v->w, v->h, 3);
+    view_read_rgb(v, 0, 0, v->w, v->h, img->data);
+    return img;
+}
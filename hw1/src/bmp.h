@@ -0,0 +1,45 @@
+#ifndef BMP_H
+#define BMP_H
+
+#include <stddef.h>
+#include "image.h"
+
+// Native reader for uncompressed 8-bit (palette) and 24-bit BMP files (bmp.c).
+// The file is mmapped and exposed as a view whose rows point straight into the
+// pixel array: bottom-up files (the common case) get a negative stride, and
+// 24-bit pixels keep their on-disk BGR order. Opening only parses the header.
+
+typedef enum
+{
+    ORDER_RGB,
+    ORDER_BGR
+} ChannelOrder;
+
+typedef struct
+{
+    int w, h;
+    int bpp;                      // bytes per pixel in the mapped rows (1 = palette index, 3 = 24-bit)
+    const unsigned char *row0;    // top row of the image
+    long stride;                  // bytes from row y to row y+1 (negative for bottom-up files)
+    ChannelOrder order;           // channel order of 24-bit pixels
+    const unsigned char *palette; // BGRX entries for 8-bit files, NULL otherwise
+    int palette_n;
+    int gray;                     // palette is the identity gray ramp: indices are gray levels
+    void *map;
+    size_t map_len;
+} ImageView;
+
+int bmp_open_view(const char *path, ImageView *v); // 0 if not a supported BMP (use stb instead)
+int bmp_view_from_memory(const unsigned char *buf, size_t len, ImageView *v); // view into buf, nothing to close
+void bmp_close_view(ImageView *v);
+
+static inline const unsigned char *view_row(const ImageView *v, int y)
+{
+    return v->row0 + (long)y * v->stride;
+}
+
+// copy the w x h block at (x, y) to dst as packed RGB rows (3 bytes per pixel)
+void view_read_rgb(const ImageView *v, int x, int y, int w, int h, unsigned char *dst);
+Image *image_from_view(const ImageView *v); // 3-channel RGB, same pixels as stbi_load
+
+#endif
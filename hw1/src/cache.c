@@ -0,0 +1,312 @@
+// Content-addressed result cache.
+// 結果以「輸入檔內容的 hash + 運算描述」為 key 存成 <dir>/<key>.png；命中時直接複製，
+// 新結果在編碼完成時由記憶體中的 PNG 寫進快取（不經過輸出檔，同名的輸出互相覆蓋也不影響），
+// 結束時再依 mtime 刪掉最舊的檔案直到總大小低於上限。
+
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include "path.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define CACHE_VERSION 1 // 演算法或輸出格式改變時遞增，讓舊的結果失效
+#define ENTRY_MAX (OUT_PATH_MAX + 40) // <dir>/<32 個 hex>.png
+
+static struct
+{
+    char dir[OUT_PATH_MAX];
+    int on;
+    pthread_mutex_t lock;
+    long tmp_seq;
+    CacheStats st;
+} cache = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+// ---------------- XXH64 ----------------
+#define P1 0x9E3779B185EBCA87ULL
+#define P2 0xC2B2AE3D27D4EB4FULL
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+#define P5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t in)
+{
+    return rotl64(acc + in * P2, 31) * P1;
+}
+
+static inline uint64_t xxh_merge(uint64_t h, uint64_t v)
+{
+    return (h ^ xxh_round(0, v)) * P1 + P4;
+}
+
+/** 每次處理 32 位元組、四條獨立的乘法鏈，速度接近記憶體頻寬 */
+static uint64_t hash64(const unsigned char *p, size_t len, uint64_t seed)
+{
+    const unsigned char *end = p + len;
+    uint64_t h;
+    if (len >= 32)
+    {
+        uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+        do
+        {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    }
+    else
+    {
+        h = seed + P5;
+    }
+    h += len;
+    for (; p + 8 <= end; p += 8)
+        h = rotl64(h ^ xxh_round(0, read64(p)), 27) * P1 + P4;
+    if (p + 4 <= end)
+    {
+        uint32_t k;
+        memcpy(&k, p, 4);
+        h = rotl64(h ^ (k * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = rotl64(h ^ (*p * P5), 11) * P1;
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// ---------------- files ----------------
+static void entry_path(const CacheKey *key, char *buf, size_t n)
+{
+    snprintf(buf, n, "%s/%016llx%016llx.png", cache.dir, key->input, key->op);
+}
+
+/** 同目錄下的暫存檔名（pid + 序號），寫完再 rename，其他行程不會看到寫到一半的檔案 */
+static int open_tmp(const char *dst, char *tmp, size_t n)
+{
+    pthread_mutex_lock(&cache.lock);
+    long seq = cache.tmp_seq++;
+    pthread_mutex_unlock(&cache.lock);
+    snprintf(tmp, n, "%s.%ld.%ld.tmp", dst, (long)getpid(), seq);
+    return open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+static int finish_tmp(int fd, int ok, const char *tmp, const char *dst)
+{
+    if (fd >= 0)
+        ok = close(fd) == 0 && ok;
+    if (ok)
+        ok = rename(tmp, dst) == 0;
+    if (!ok)
+        unlink(tmp);
+    return ok;
+}
+
+static int copy_file(const char *src, const char *dst)
+{
+    int in = open(src, O_RDONLY);
+    if (in < 0)
+        return 0;
+    char tmp[ENTRY_MAX + 48];
+    int out = open_tmp(dst, tmp, sizeof(tmp));
+    int ok = out >= 0;
+    char buf[65536];
+    ssize_t n;
+    while (ok && (n = read(in, buf, sizeof(buf))) > 0)
+        ok = write(out, buf, (size_t)n) == n;
+    close(in);
+    return finish_tmp(out, ok, tmp, dst);
+}
+
+static int write_file(const unsigned char *data, size_t len, const char *dst)
+{
+    char tmp[ENTRY_MAX + 48];
+    int out = open_tmp(dst, tmp, sizeof(tmp));
+    int ok = out >= 0;
+    while (ok && len > 0)
+    {
+        ssize_t n = write(out, data, len);
+        ok = n > 0;
+        if (ok)
+        {
+            data += n;
+            len -= (size_t)n;
+        }
+    }
+    return finish_tmp(out, ok, tmp, dst);
+}
+
+int cache_open(const char *dir, size_t max_bytes)
+{
+    if (strlen(dir) >= sizeof(cache.dir) || ensure_dir(dir) != 0)
+        return 0;
+    strcpy(cache.dir, dir);
+    cache.st.limit = max_bytes;
+    cache.on = 1;
+    return 1;
+}
+
+int cache_enabled(void)
+{
+    return cache.on;
+}
+
+/** 輸入檔以 mmap 讀進來 hash；命中時這是唯一一次讀取輸入 */
+int cache_key(const char *in_path, const char *desc, CacheKey *key)
+{
+    if (!cache.on)
+        return 0;
+    int fd = open(in_path, O_RDONLY);
+    struct stat sb;
+    if (fd < 0 || fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode))
+    {
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    size_t len = (size_t)sb.st_size;
+    void *map = len ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+    key->input = hash64((const unsigned char *)map, len, CACHE_VERSION);
+    key->op = hash64((const unsigned char *)desc, strlen(desc), key->input);
+    if (map)
+        munmap(map, len);
+    return 1;
+}
+
+int cache_fetch(const CacheKey *key, const char *out_path)
+{
+    char entry[ENTRY_MAX];
+    entry_path(key, entry, sizeof(entry));
+    int hit = copy_file(entry, out_path);
+    if (hit)
+        utimensat(AT_FDCWD, entry, NULL, 0); // LRU：命中時更新 mtime
+    pthread_mutex_lock(&cache.lock);
+    cache.st.lookups++;
+    cache.st.hits += hit;
+    pthread_mutex_unlock(&cache.lock);
+    return hit;
+}
+
+/** 編碼後的 PNG 直接寫成快取檔：內容一定是這個 key 的結果，與輸出檔之後被誰覆蓋無關 */
+void cache_store(const CacheKey *key, const unsigned char *png, size_t len)
+{
+    char entry[ENTRY_MAX];
+    entry_path(key, entry, sizeof(entry));
+    int ok = write_file(png, len, entry);
+    pthread_mutex_lock(&cache.lock);
+    cache.st.stores += ok;
+    pthread_mutex_unlock(&cache.lock);
+}
+
+typedef struct
+{
+    char name[40];
+    size_t size;
+    struct timespec mtime;
+} Entry;
+
+static int cmp_mtime(const void *a, const void *b)
+{
+    const struct timespec *ta = &((const Entry *)a)->mtime, *tb = &((const Entry *)b)->mtime;
+    if (ta->tv_sec != tb->tv_sec)
+        return ta->tv_sec < tb->tv_sec ? -1 : 1;
+    return (ta->tv_nsec > tb->tv_nsec) - (ta->tv_nsec < tb->tv_nsec);
+}
+
+/** 掃描快取目錄，總大小超過上限時由最久未使用的檔案開始刪除 */
+static void evict(void)
+{
+    DIR *d = opendir(cache.dir);
+    if (!d)
+        return;
+    int dfd = dirfd(d);
+    int n = 0, cap = 64;
+    Entry *e = (Entry *)malloc(sizeof(Entry) * cap);
+    size_t total = 0;
+    struct dirent *de;
+    while ((de = readdir(d)))
+    {
+        size_t nl = strlen(de->d_name);
+        if (nl != 36 || strcmp(de->d_name + 32, ".png") != 0)
+            continue;
+        struct stat sb;
+        if (fstatat(dfd, de->d_name, &sb, 0) != 0)
+            continue;
+        if (n == cap)
+        {
+            cap *= 2;
+            e = (Entry *)realloc(e, sizeof(Entry) * cap);
+        }
+        memcpy(e[n].name, de->d_name, nl + 1);
+        e[n].size = (size_t)sb.st_size;
+        e[n].mtime = sb.st_mtim;
+        total += e[n].size;
+        n++;
+    }
+    if (total > cache.st.limit)
+    {
+        qsort(e, n, sizeof(Entry), cmp_mtime);
+        for (int i = 0; i < n && total > cache.st.limit; ++i)
+        {
+            if (unlinkat(dfd, e[i].name, 0) == 0)
+            {
+                total -= e[i].size;
+                cache.st.evictions++;
+            }
+        }
+    }
+    closedir(d);
+    cache.st.bytes = total;
+    free(e);
+}
+
+void cache_close(void)
+{
+    if (!cache.on)
+        return;
+    evict();
+    const CacheStats *st = &cache.st;
+    printf("cache: %ld lookups, %ld hits (%.0f%%), %ld stored, %ld evicted, %.1f MB of %.1f MB\n",
+           st->lookups, st->hits, st->lookups ? 100.0 * st->hits / st->lookups : 0.0, st->stores,
+           st->evictions, st->bytes / 1048576.0, st->limit / 1048576.0);
+    cache.on = 0;
+}
+
+void cache_stats(CacheStats *out)
+{
+    pthread_mutex_lock(&cache.lock);
+    *out = cache.st;
+    pthread_mutex_unlock(&cache.lock);
+}
@@ -0,0 +1,40 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+// Content-addressed result cache (cache.c).
+// An output PNG is filed under a key made of a hash of the input file's bytes
+// and a descriptor of the operation ("point_op gamma 2.2", resize size and
+// method, pixel depth, ...). A later run with the same key copies the cached
+// file instead of decoding, computing and encoding again. Entries are plain
+// files in one directory; the total size is kept under a limit by deleting the
+// least recently used ones (hits refresh an entry's mtime).
+
+typedef struct
+{
+    unsigned long long input; // hash of the input file
+    unsigned long long op;    // hash of the descriptor, seeded with `input`
+} CacheKey;
+
+typedef struct
+{
+    long lookups, hits;
+    long stores, evictions;
+    size_t bytes; // size of the cache directory after the last cache_close
+    size_t limit;
+} CacheStats;
+
+// enable the process-wide cache; call once at startup, before threads
+int cache_open(const char *dir, size_t max_bytes); // 0 if dir cannot be created
+int cache_enabled(void);
+
+int cache_key(const char *in_path, const char *desc, CacheKey *key); // 0 if disabled or unreadable
+int cache_fetch(const CacheKey *key, const char *out_path);          // 1 on a hit: out_path holds the result
+// file the encoded result for key (written at once, independent of the output path)
+void cache_store(const CacheKey *key, const unsigned char *png, size_t len);
+void cache_close(void); // evict down to the limit, print stats
+
+void cache_stats(CacheStats *out);
+
+#endif
@@ -0,0 +1,480 @@
+// Histograms and image statistics.
+// 每個 row band 有自己的計數表（每個通道四份，相鄰的樣本輪流寫不同的表，
+// 避免同一個計數器連續 ++ 時的 store-to-load 相依），全部算完後再合併。
+
+#include "hist.h"
+#include "sched.h"
+#include "kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HIST_COPIES 4
+
+typedef struct
+{
+    unsigned int t[HIST_COPIES][PLANAR_MAX_CHANNELS][HIST_BINS];
+    double min[PLANAR_MAX_CHANNELS], max[PLANAR_MAX_CHANNELS];
+    double sum[PLANAR_MAX_CHANNELS], sumsq[PLANAR_MAX_CHANNELS]; // u8 以外才用（u8 由直方圖直接算）
+} HistBand;
+
+typedef struct
+{
+    const Image *img;
+    HistBand *bands;
+    int rows;
+} HistJob;
+
+/** 多通道 8-bit：以像素為單位輪流寫四份表；c 為常數時內層迴圈會被展開 */
+static inline void count_u8_interleaved(const unsigned char *p, size_t npx, int c, HistBand *b)
+{
+    size_t i = 0;
+    for (; i + 4 <= npx; i += 4, p += 4 * c)
+    {
+        for (int k = 0; k < c; ++k)
+        {
+            b->t[0][k][p[k]]++;
+            b->t[1][k][p[c + k]]++;
+            b->t[2][k][p[2 * c + k]]++;
+            b->t[3][k][p[3 * c + k]]++;
+        }
+    }
+    for (; i < npx; ++i, p += c)
+        for (int k = 0; k < c; ++k)
+            b->t[0][k][p[k]]++;
+}
+
+/** 8-bit：單通道時四個連續樣本寫四份表 */
+static void count_u8(const unsigned char *p, size_t npx, int c, HistBand *b)
+{
+    if (c == 3)
+    {
+        count_u8_interleaved(p, npx, 3, b);
+        return;
+    }
+    if (c != 1)
+    {
+        count_u8_interleaved(p, npx, c, b);
+        return;
+    }
+    unsigned int *t0 = b->t[0][0], *t1 = b->t[1][0], *t2 = b->t[2][0], *t3 = b->t[3][0];
+    size_t i = 0;
+    for (; i + 4 <= npx; i += 4)
+    {
+        t0[p[i]]++;
+        t1[p[i + 1]]++;
+        t2[p[i + 2]]++;
+        t3[p[i + 3]]++;
+    }
+    for (; i < npx; ++i)
+        t0[p[i]]++;
+}
+
+static inline int bin_u16(unsigned short v)
+{
+    return v >> 8;
+}
+
+static inline int bin_f32(float v)
+{
+    int b = (int)(v * 256.0f);
+    return b < 0 ? 0 : (b > HIST_BINS - 1 ? HIST_BINS - 1 : b);
+}
+
+// u16 / f32：分箱之外順便累計 min / max / sum / sum^2
+#define DEFINE_COUNT_WIDE(SUFFIX, T, BIN)                                           \
+    static void count_##SUFFIX(const T *p, size_t npx, int c, HistBand *b)          \
+    {                                                                               \
+        for (size_t i = 0; i < npx; ++i, p += c)                                    \
+        {                                                                           \
+            unsigned int(*t)[HIST_BINS] = b->t[i & (HIST_COPIES - 1)];              \
+            for (int k = 0; k < c; ++k)                                             \
+            {                                                                       \
+                double v = p[k];                                                    \
+                t[k][BIN(p[k])]++;                                                  \
+                if (v < b->min[k])                                                  \
+                    b->min[k] = v;                                                  \
+                if (v > b->max[k])                                                  \
+                    b->max[k] = v;                                                  \
+                b->sum[k] += v;                                                     \
+                b->sumsq[k] += v * v;                                               \
+            }                                                                       \
+        }                                                                           \
+    }
+
+DEFINE_COUNT_WIDE(u16, unsigned short, bin_u16)
+DEFINE_COUNT_WIDE(f32, float, bin_f32)
+
+static void hist_band(void *arg, int y0, int y1)
+{
+    HistJob *job = (HistJob *)arg;
+    const Image *img = job->img;
+    HistBand *b = &job->bands[y0 / job->rows];
+    memset(b, 0, sizeof(*b));
+    for (int k = 0; k < img->c; ++k)
+    {
+        b->min[k] = INFINITY;
+        b->max[k] = -INFINITY;
+    }
+    size_t row = (size_t)img->w * img->c;
+    size_t npx = (size_t)img->w * (y1 - y0);
+    if (img->type == PIXEL_U16)
+        count_u16((const unsigned short *)img->data + y0 * row, npx, img->c, b);
+    else if (img->type == PIXEL_F32)
+        count_f32((const float *)img->data + y0 * row, npx, img->c, b);
+    else
+        count_u8(img->data + y0 * row, npx, img->c, b);
+}
+
+int image_stats(const Image *img, ImageStats *st)
+{
+    if (img->c < 1 || img->c > PLANAR_MAX_CHANNELS)
+        return 0;
+    memset(st, 0, sizeof(*st));
+    st->c = img->c;
+    st->type = img->type;
+    st->n = (size_t)img->w * img->h;
+    if (st->n == 0)
+        return 1;
+
+    HistJob job = {img, NULL, sched_band_rows(img->h)};
+    int nb = (img->h + job.rows - 1) / job.rows;
+    job.bands = (HistBand *)malloc(sizeof(HistBand) * nb);
+    sched_parallel_for(sched_default(), 0, img->h, job.rows, hist_band, &job);
+
+    double sum[PLANAR_MAX_CHANNELS] = {0}, sumsq[PLANAR_MAX_CHANNELS] = {0};
+    for (int k = 0; k < img->c; ++k)
+    {
+        st->min[k] = INFINITY;
+        st->max[k] = -INFINITY;
+    }
+    for (int i = 0; i < nb; ++i)
+    {
+        const HistBand *b = &job.bands[i];
+        for (int k = 0; k < img->c; ++k)
+        {
+            for (int j = 0; j < HIST_COPIES; ++j)
+                for (int v = 0; v < HIST_BINS; ++v)
+                    st->bins[k][v] += b->t[j][k][v];
+            st->min[k] = fmin(st->min[k], b->min[k]);
+            st->max[k] = fmax(st->max[k], b->max[k]);
+            sum[k] += b->sum[k];
+            sumsq[k] += b->sumsq[k];
+        }
+    }
+    free(job.bands);
+
+    for (int k = 0; k < img->c; ++k)
+    {
+        if (img->type == PIXEL_U8)
+        {
+            // 8-bit 的每個 bin 就是一個數值，直接由直方圖得到精確的統計量
+            sum[k] = sumsq[k] = 0;
+            for (int v = 0; v < HIST_BINS; ++v)
+            {
+                if (!st->bins[k][v])
+                    continue;
+                if (v < st->min[k])
+                    st->min[k] = v;
+                st->max[k] = v;
+                sum[k] += (double)st->bins[k][v] * v;
+                sumsq[k] += (double)st->bins[k][v] * v * v;
+            }
+        }
+        st->mean[k] = sum[k] / st->n;
+        double var = sumsq[k] / st->n - st->mean[k] * st->mean[k];
+        st->std[k] = var > 0 ? sqrt(var) : 0.0;
+    }
+    return 1;
+}
+
+int hist_percentile(const unsigned long long *bins, size_t n, double p)
+{
+    double target = p * n;
+    unsigned long long acc = 0;
+    for (int v = 0; v < HIST_BINS; ++v)
+    {
+        acc += bins[v];
+        if (acc > 0 && acc >= target)
+            return v;
+    }
+    return HIST_BINS - 1;
+}
+
+/** 使 pow(mean, gamma) = 0.5：暗的影像得到 < 1 的 gamma（提亮），亮的則 > 1 */
+double auto_gamma(const ImageStats *st)
+{
+    double full = st->type == PIXEL_U16 ? 65535.0 : (st->type == PIXEL_F32 ? 1.0 : 255.0);
+    double m = 0;
+    for (int k = 0; k < st->c; ++k)
+        m += st->mean[k];
+    m /= (st->c > 0 ? st->c : 1) * full;
+    if (m <= 0.0 || m >= 1.0)
+        return 1.0;
+    double g = log(0.5) / log(m);
+    return g < 0.1 ? 0.1 : (g > 10.0 ? 10.0 : g);
+}
+
+/** 依影像統計選出 gamma（寫到 *gamma）後套用 */
+int point_auto_gamma_into(const Image *img, Image *out, double *gamma)
+{
+    ImageStats st;
+    double g = image_stats(img, &st) ? auto_gamma(&st) : 1.0;
+    if (gamma)
+        *gamma = g;
+    return point_gamma_into(img, out, g);
+}
+
+Image *point_auto_gamma(const Image *img, double *gamma)
+{
+    Image *out = create_image_like(img);
+    return point_result(out, point_auto_gamma_into(img, out, gamma));
+}
+
+/** 所有通道合併成一個直方圖：同一條曲線套用到每個通道，彩色影像不會偏色 */
+static size_t merged_bins(const ImageStats *st, unsigned long long *bins)
+{
+    memset(bins, 0, sizeof(unsigned long long) * HIST_BINS);
+    for (int k = 0; k < st->c; ++k)
+        for (int v = 0; v < HIST_BINS; ++v)
+            bins[v] += st->bins[k][v];
+    return st->n * st->c;
+}
+
+/** 直方圖等化：曲線為累積分佈，扣掉最小值所在的 bin 讓輸出從 0 開始 */
+int point_equalize_into(const Image *img, Image *out)
+{
+    ImageStats st;
+    unsigned long long bins[HIST_BINS];
+    float lut[HIST_BINS];
+    if (!image_stats(img, &st))
+        return 0;
+    size_t n = merged_bins(&st, bins);
+    unsigned long long first = 0, acc = 0;
+    for (int v = 0; v < HIST_BINS && !first; ++v)
+        first = bins[v];
+    for (int v = 0; v < HIST_BINS; ++v)
+    {
+        acc += bins[v];
+        lut[v] = n > first ? (float)((double)(acc > first ? acc - first : 0) / (n - first)) : v / 255.0f;
+    }
+    return point_lut_into(img, out, lut);
+}
+
+Image *point_equalize(const Image *img)
+{
+    Image *out = create_image_like(img);
+    return point_result(out, point_equalize_into(img, out));
+}
+
+/** 線性拉伸：兩端各捨去 percent% 的樣本，其間線性映射到整個範圍 */
+int point_stretch_into(const Image *img, Image *out, double percent)
+{
+    ImageStats st;
+    unsigned long long bins[HIST_BINS];
+    float lut[HIST_BINS];
+    if (!image_stats(img, &st))
+        return 0;
+    size_t n = merged_bins(&st, bins);
+    double p = percent < 0 ? 0 : (percent > 49 ? 0.49 : percent / 100.0);
+    int lo = hist_percentile(bins, n, p), hi = hist_percentile(bins, n, 1.0 - p);
+    for (int v = 0; v < HIST_BINS; ++v)
+    {
+        double t = hi > lo ? (double)(v - lo) / (hi - lo) : v / 255.0;
+        lut[v] = (float)(t < 0 ? 0 : (t > 1 ? 1 : t));
+    }
+    return point_lut_into(img, out, lut);
+}
+
+Image *point_stretch(const Image *img, double percent)
+{
+    Image *out = create_image_like(img);
+    return point_result(out, point_stretch_into(img, out, percent));
+}
+
+// ---------------- CLAHE ----------------
+typedef struct
+{
+    const Image *img;
+    int gx, gy;
+    double clip;
+    Image *out;
+    float (*lut)[HIST_BINS]; // gx*gy 條曲線，row-major
+    const int *x0, *x1, *y0, *y1;
+    const double *wx, *wy;
+    float *wf; // wx 的 float 版本（u8 路徑）
+} ClaheJob;
+
+/** 第 i 個 tile 的範圍：[i*n/g, (i+1)*n/g) */
+static inline int tile_edge(int i, int n, int g)
+{
+    return (int)((long)i * n / g);
+}
+
+/** 一個 tile 的直方圖（所有通道合併）→ 截斷超過上限的 bin 並平均分回 → 累積分佈 */
+static void clahe_tile(void *arg, int t0, int t1)
+{
+    ClaheJob *job = (ClaheJob *)arg;
+    const Image *img = job->img;
+    HistBand b;
+    for (int t = t0; t < t1; ++t)
+    {
+        int tx = t % job->gx, ty = t / job->gx;
+        int xa = tile_edge(tx, img->w, job->gx), xb = tile_edge(tx + 1, img->w, job->gx);
+        int ya = tile_edge(ty, img->h, job->gy), yb = tile_edge(ty + 1, img->h, job->gy);
+        memset(&b, 0, sizeof(b));
+        size_t row = (size_t)img->w * img->c, off = (size_t)xa * img->c;
+        for (int y = ya; y < yb; ++y)
+        {
+            if (img->type == PIXEL_U16)
+                count_u16((const unsigned short *)img->data + y * row + off, xb - xa, img->c, &b);
+            else if (img->type == PIXEL_F32)
+                count_f32((const float *)img->data + y * row + off, xb - xa, img->c, &b);
+            else
+                count_u8(img->data + y * row + off, xb - xa, img->c, &b);
+        }
+        double h[HIST_BINS] = {0};
+        for (int j = 0; j < HIST_COPIES; ++j)
+            for (int k = 0; k < img->c; ++k)
+                for (int v = 0; v < HIST_BINS; ++v)
+                    h[v] += b.t[j][k][v];
+        double n = (double)(xb - xa) * (yb - ya) * img->c;
+        double limit = job->clip * n / HIST_BINS, excess = 0;
+        if (limit < 1)
+            limit = 1;
+        for (int v = 0; v < HIST_BINS; ++v)
+        {
+            if (h[v] > limit)
+            {
+                excess += h[v] - limit;
+                h[v] = limit;
+            }
+        }
+        double acc = 0, share = excess / HIST_BINS;
+        float *lut = job->lut[t];
+        for (int v = 0; v < HIST_BINS; ++v)
+        {
+            acc += h[v] + share;
+            lut[v] = n > 0 ? (float)(acc / n) : v / 255.0f;
+        }
+    }
+}
+
+/** 8-bit 一列：mix 中每條曲線已乘上 255，c 為常數時內層迴圈會被展開 */
+static inline void clahe_row_u8(const unsigned char *src, unsigned char *dst, int w, int c, const float *mix,
+                                const ClaheJob *job)
+{
+    for (int x = 0; x < w; ++x, src += c, dst += c)
+    {
+        const float *l = &mix[job->x0[x] * HIST_BINS], *r = &mix[job->x1[x] * HIST_BINS];
+        float wx = job->wf[x];
+        for (int k = 0; k < c; ++k)
+            dst[k] = (unsigned char)(l[src[k]] + (r[src[k]] - l[src[k]]) * wx + 0.5f);
+    }
+}
+
+/** 輸出列 y：先把上下兩列 tile 的曲線依 wy 混合，每個像素再於左右兩個 tile 之間依 wx 內插 */
+static void clahe_apply(void *arg, int ya, int yb)
+{
+    ClaheJob *job = (ClaheJob *)arg;
+    const Image *img = job->img;
+    int c = img->c, gx = job->gx;
+    size_t row = (size_t)img->w * c;
+    float *mix = (float *)malloc(sizeof(float) * gx * HIST_BINS);
+    for (int y = ya; y < yb; ++y)
+    {
+        const float(*top)[HIST_BINS] = &job->lut[job->y0[y] * gx];
+        const float(*bot)[HIST_BINS] = &job->lut[job->y1[y] * gx];
+        float wy = (float)job->wy[y];
+        float scale = img->type == PIXEL_U8 ? 255.0f : 1.0f;
+        for (int j = 0; j < gx; ++j)
+            for (int v = 0; v < HIST_BINS; ++v)
+                mix[j * HIST_BINS + v] = (top[j][v] + (bot[j][v] - top[j][v]) * wy) * scale;
+        if (img->type == PIXEL_U8)
+        {
+            const unsigned char *src = img->data + y * row;
+            unsigned char *dst = job->out->data + y * row;
+            if (c == 1)
+                clahe_row_u8(src, dst, img->w, 1, mix, job);
+            else if (c == 3)
+                clahe_row_u8(src, dst, img->w, 3, mix, job);
+            else
+                clahe_row_u8(src, dst, img->w, c, mix, job);
+            continue;
+        }
+        for (int x = 0; x < img->w; ++x)
+        {
+            const float *l = &mix[job->x0[x] * HIST_BINS], *r = &mix[job->x1[x] * HIST_BINS];
+            double wx = job->wx[x];
+            size_t i = y * row + (size_t)x * c;
+            for (int k = 0; k < c; ++k, ++i)
+            {
+                double v = img->type == PIXEL_U16 ? ((const unsigned short *)img->data)[i]
+                                                  : ((const float *)img->data)[i];
+                double tl = lut_sample(l, img->type, v);
+                double t = tl + (lut_sample(r, img->type, v) - tl) * wx;
+                if (img->type == PIXEL_U16)
+                {
+                    t = t < 0 ? 0 : (t > 1 ? 1 : t); // 曲線的浮點累加可能略超過 1
+                    ((unsigned short *)job->out->data)[i] = (unsigned short)(65535.0 * t + 0.5);
+                }
+                else
+                    ((float *)job->out->data)[i] = (float)t;
+            }
+        }
+    }
+    free(mix);
+}
+
+/** 每個 tile 的曲線平行計算；套用時的內插權重沿用縮放的 bilinear 座標表（tile 中心即來源像素中心）。
+ *  所有曲線都在套用前算好，套用時每個樣本只讀寫自己的位置，因此 out 可以就是 img */
+int point_clahe_into(const Image *img, Image *out, int tiles, double clip)
+{
+    if (img->c < 1 || img->c > PLANAR_MAX_CHANNELS || img->w < 1 || img->h < 1 || !out || out->w != img->w ||
+        out->h != img->h || out->c != img->c || out->type != img->type)
+        return 0;
+    if (tiles < 1)
+        tiles = 1;
+    ClaheJob job;
+    job.img = img;
+    job.gx = tiles < img->w ? tiles : img->w;
+    job.gy = tiles < img->h ? tiles : img->h;
+    job.clip = clip > 0 ? clip : 2.0;
+    job.out = out;
+    job.lut = (float(*)[HIST_BINS])malloc(sizeof(float) * HIST_BINS * job.gx * job.gy);
+    int *x0 = (int *)malloc(sizeof(int) * img->w), *x1 = (int *)malloc(sizeof(int) * img->w);
+    int *y0 = (int *)malloc(sizeof(int) * img->h), *y1 = (int *)malloc(sizeof(int) * img->h);
+    double *wx = (double *)malloc(sizeof(double) * img->w), *wy = (double *)malloc(sizeof(double) * img->h);
+    bilinear_axis_table(job.gx, img->w, x0, x1, wx);
+    bilinear_axis_table(job.gy, img->h, y0, y1, wy);
+    job.x0 = x0;
+    job.x1 = x1;
+    job.y0 = y0;
+    job.y1 = y1;
+    job.wx = wx;
+    job.wy = wy;
+    job.wf = (float *)malloc(sizeof(float) * img->w);
+    for (int x = 0; x < img->w; ++x)
+        job.wf[x] = (float)wx[x];
+
+    Scheduler *s = sched_default();
+    sched_parallel_for(s, 0, job.gx * job.gy, 1, clahe_tile, &job);
+    int rows = 65536 / (img->w * img->c);
+    sched_parallel_for(s, 0, img->h, rows > 0 ? rows : 1, clahe_apply, &job);
+
+    free(job.lut);
+    free(x0);
+    free(x1);
+    free(y0);
+    free(y1);
+    free(wx);
+    free(wy);
+    free(job.wf);
+    return 1;
+}
+
+Image *point_clahe(const Image *img, int tiles, double clip)
+{
+    Image *out = create_image_like(img);
+    return point_result(out, point_clahe_into(img, out, tiles, clip));
+}
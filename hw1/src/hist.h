@@ -0,0 +1,33 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stddef.h>
+#include "image.h"
+
+// Per-channel histograms and statistics (hist.c).
+// Samples of every pixel type are binned into 256 levels (u16 by the high
+// byte, f32 clamped to 0..1). Row bands are counted in parallel, each into its
+// own private tables (four copies per channel, so neighbouring samples never
+// increment the same counter back to back), and merged at the end.
+
+#define HIST_BINS 256
+
+typedef struct
+{
+    int c;
+    PixelType type;
+    size_t n; // samples per channel (w*h)
+    unsigned long long bins[PLANAR_MAX_CHANNELS][HIST_BINS];
+    double min[PLANAR_MAX_CHANNELS], max[PLANAR_MAX_CHANNELS]; // in sample units
+    double mean[PLANAR_MAX_CHANNELS], std[PLANAR_MAX_CHANNELS];
+} ImageStats;
+
+int image_stats(const Image *img, ImageStats *st); // 0 if img has more than PLANAR_MAX_CHANNELS channels
+int hist_percentile(const unsigned long long *bins, size_t n, double p); // first bin reaching fraction p (0..1)
+
+// gamma that moves the mean level (averaged over channels) to mid-scale
+double auto_gamma(const ImageStats *st);
+Image *point_auto_gamma(const Image *img, double *gamma); // *gamma receives the chosen value (may be NULL)
+int point_auto_gamma_into(const Image *img, Image *out, double *gamma); // out may be img (see image.h)
+
+#endif
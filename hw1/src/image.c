@@ -1,94 +1,457 @@
+#include "pool.h"
+#include "io.h"
+// stb 的配置也走影像用的 buffer pool：解碼結果可以直接被 Image 採用並還回同一個 pool
+#define STBI_MALLOC(sz) pool_alloc(image_pool(), sz)
+#define STBI_REALLOC(p, newsz) pool_realloc(image_pool(), p, newsz)
+#define STBI_FREE(p) pool_free(image_pool(), p)
+#define STBIW_MALLOC(sz) pool_alloc(image_pool(), sz)
+#define STBIW_REALLOC(p, newsz) pool_realloc(image_pool(), p, newsz)
+#define STBIW_FREE(p) pool_free(image_pool(), p)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
 #include "image.h"
+#include "bmp.h"
+#include "kernels.h"
+#include "sched.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-static char stem_buf[256];
+static int verbose = 1;
 
-const char *file_stem(const char *path)
+/** 關閉讀檔訊息（benchmark 與大量批次時使用） */
+void set_verbose(int on)
 {
-    const char *slash = strrchr(path, '/');
-#ifdef _WIN32
-    const char *bslash = strrchr(path, '\\');
-    if (!slash || (bslash && bslash > slash))
-        slash = bslash;
-#endif
-    const char *name = slash ? slash + 1 : path;
-    snprintf(stem_buf, sizeof(stem_buf), "%s", name);
-    char *dot = strrchr(stem_buf, '.');
-    if (dot)
-        *dot = '\0';
-    return stem_buf;
+    verbose = on;
+}
+
+size_t pixel_size(PixelType type)
+{
+    return type == PIXEL_U16 ? 2 : (type == PIXEL_F32 ? 4 : 1);
+}
+
+int pixel_type_from_name(const char *name, PixelType *out)
+{
+    if (strcmp(name, "8") == 0 || strcmp(name, "u8") == 0)
+        *out = PIXEL_U8;
+    else if (strcmp(name, "16") == 0 || strcmp(name, "u16") == 0)
+        *out = PIXEL_U16;
+    else if (strcmp(name, "f32") == 0 || strcmp(name, "float") == 0)
+        *out = PIXEL_F32;
+    else
+        return 0;
+    return 1;
 }
 
 /**  分配image所需的記憶體空間 */
-Image *create_image(int w, int h, int c)
+Image *create_image_typed(int w, int h, int c, PixelType type)
 {
     Image *img = (Image *)malloc(sizeof(Image));
     img->w = w;
     img->h = h;
     img->c = c;
-    img->data = (unsigned char *)malloc((size_t)w * h * c);
+    img->type = type;
+    img->data = (unsigned char *)pool_alloc(image_pool(), (size_t)w * h * c * pixel_size(type));
     return img;
 }
 
+Image *create_image_like(const Image *img)
+{
+    return create_image_typed(img->w, img->h, img->c, img->type);
+}
+
+Image *create_image(int w, int h, int c)
+{
+    return create_image_typed(w, h, c, PIXEL_U8);
+}
+
 /** 釋放image的記憶體 */
 void free_image(Image *img)
 {
     if (!img)
         return;
-    free(img->data);
+    pool_free(image_pool(), img->data);
     free(img);
 }
 
-Image *read_image(const char *path)
+/** 轉換像素型別：先換算成 0..1，再乘上目標的最大值；變窄時四捨五入並 clamp */
+Image *convert_image(const Image *img, PixelType type)
+{
+    Image *out = create_image_typed(img->w, img->h, img->c, type);
+    size_t n = (size_t)img->w * img->h * img->c;
+    if (img->type == type)
+    {
+        memcpy(out->data, img->data, n * pixel_size(type));
+        return out;
+    }
+    const unsigned char *s8 = img->data;
+    const unsigned short *s16 = (const unsigned short *)img->data;
+    const float *s32 = (const float *)img->data;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (img->type == PIXEL_U8 && type == PIXEL_U16)
+        {
+            ((unsigned short *)out->data)[i] = (unsigned short)(s8[i] * 257);
+            continue;
+        }
+        if (img->type == PIXEL_U16 && type == PIXEL_U8)
+        {
+            out->data[i] = (unsigned char)((s16[i] * 255u + 32767u) / 65535u);
+            continue;
+        }
+        double v = img->type == PIXEL_U8 ? s8[i] / 255.0 : (img->type == PIXEL_U16 ? s16[i] / 65535.0 : s32[i]);
+        if (type == PIXEL_F32)
+        {
+            ((float *)out->data)[i] = (float)v;
+            continue;
+        }
+        v = v < 0.0 ? 0.0 : (v > 1.0 ? 1.0 : v);
+        if (type == PIXEL_U8)
+            out->data[i] = (unsigned char)lrint(v * 255.0);
+        else
+            ((unsigned short *)out->data)[i] = (unsigned short)lrint(v * 65535.0);
+    }
+    return out;
+}
+
+static const char *type_label(PixelType type)
+{
+    return type == PIXEL_U16 ? ", 16-bit" : (type == PIXEL_F32 ? ", float" : "");
+}
+
+/** 型別不同時轉換並釋放原影像 */
+static Image *to_type(Image *img, PixelType type)
+{
+    if (!img || img->type == type)
+        return img;
+    Image *conv = convert_image(img, type);
+    free_image(img);
+    return conv;
+}
+
+static Image *wrap_pixels(void *data, int w, int h, int c, PixelType type)
 {
-    int w, h, c;
-    unsigned char *data = stbi_load(path, &w, &h, &c, 0);
-    if (!data)
-        return NULL;
     Image *img = (Image *)malloc(sizeof(Image));
     img->w = w;
     img->h = h;
     img->c = c;
-    img->data = data;
-    printf("Loaded %s: %dx%d, %d channels\n", path, w, h, c);
+    img->type = type;
+    img->data = (unsigned char *)data;
     return img;
 }
 
-Image *read_raw(const char *path, int w, int h, int c)
+Image *read_image(const char *path)
+{
+    // 未壓縮 BMP 走原生路徑：mmap 後一次完成翻轉與轉換，不經 stb 的通用解析
+    ImageView v;
+    if (bmp_open_view(path, &v))
+    {
+        Image *img = image_from_view(&v);
+        bmp_close_view(&v);
+        if (verbose)
+            printf("Loaded %s: %dx%d, %d channels\n", path, img->w, img->h, img->c);
+        return img;
+    }
+    int w, h, c;
+    unsigned char *data = stbi_load(path, &w, &h, &c, 0);
+    if (!data)
+        return NULL;
+    if (verbose)
+        printf("Loaded %s: %dx%d, %d channels\n", path, w, h, c);
+    return wrap_pixels(data, w, h, c, PIXEL_U8);
+}
+
+/** u16 直接用 stbi_load_16（8-bit 檔會放大成 v*257）；f32 對 HDR 用 stbi_loadf，
+ *  其他格式經 16-bit 再除以 65535，避免 stbi_loadf 先截成 8-bit 並套 gamma */
+Image *read_image_as(const char *path, PixelType type)
+{
+    if (type == PIXEL_U8)
+        return read_image(path);
+    int w, h, c;
+    int hdr = type == PIXEL_F32 && stbi_is_hdr(path);
+    void *data = hdr ? (void *)stbi_loadf(path, &w, &h, &c, 0) : (void *)stbi_load_16(path, &w, &h, &c, 0);
+    if (!data)
+        return NULL;
+    if (verbose)
+        printf("Loaded %s: %dx%d, %d channels%s\n", path, w, h, c, type_label(type));
+    return to_type(wrap_pixels(data, w, h, c, hdr ? PIXEL_F32 : PIXEL_U16), type);
+}
+
+/** 已讀進記憶體的整個檔案（batch 預讀）：BMP view、stb from_memory，都不是時當作 RAW */
+static Image *decode_memory(const char *path, const unsigned char *buf, size_t len, const RawFormat *hint,
+                            PixelType type)
+{
+    ImageView v;
+    Image *img = NULL;
+    int w, h, c;
+    if (type == PIXEL_U8 && bmp_view_from_memory(buf, len, &v))
+    {
+        img = image_from_view(&v);
+    }
+    else if (type == PIXEL_U8)
+    {
+        unsigned char *data = stbi_load_from_memory(buf, (int)len, &w, &h, &c, 0);
+        if (data)
+            img = wrap_pixels(data, w, h, c, PIXEL_U8);
+    }
+    else
+    {
+        int hdr = type == PIXEL_F32 && stbi_is_hdr_from_memory(buf, (int)len);
+        void *data = hdr ? (void *)stbi_loadf_from_memory(buf, (int)len, &w, &h, &c, 0)
+                         : (void *)stbi_load_16_from_memory(buf, (int)len, &w, &h, &c, 0);
+        if (data)
+            img = wrap_pixels(data, w, h, c, hdr ? PIXEL_F32 : PIXEL_U16);
+    }
+    if (img)
+    {
+        if (verbose)
+            printf("Loaded %s: %dx%d, %d channels%s\n", path, img->w, img->h, img->c, type_label(type));
+        return to_type(img, type);
+    }
+
+    RawFormat fmt;
+    if (!raw_detect_size(path, (long)len, hint, &fmt))
+        return NULL;
+    img = create_image_typed(fmt.w, fmt.h, fmt.c, fmt.bits == 16 ? PIXEL_U16 : PIXEL_U8);
+    if (!raw_decode_into(buf, len, &fmt, img))
+    {
+        free_image(img);
+        return NULL;
+    }
+    if (verbose)
+        printf("Loaded %s: %dx%d, %d channels, %d-bit raw\n", path, fmt.w, fmt.h, fmt.c, fmt.bits);
+    return to_type(img, type);
+}
+
+/** 先用 stb 解碼，失敗時視為 RAW 並推測尺寸；最後轉成要求的像素型別。
+ *  設定了 I/O 佇列（batch）時，檔案內容由佇列預讀，這裡只做解碼 */
+Image *load_image_as(const char *path, const RawFormat *hint, PixelType type)
+{
+    IoQueue *io = io_default();
+    if (io)
+    {
+        unsigned char *buf;
+        size_t len;
+        if (!io_take(io, path, &buf, &len))
+            return NULL;
+        Image *img = decode_memory(path, buf, len, hint, type);
+        pool_free(image_pool(), buf);
+        return img;
+    }
+    Image *img = read_image_as(path, type);
+    if (img)
+        return img;
+    RawFormat fmt;
+    if (!raw_detect(path, hint, &fmt))
+        return NULL;
+    img = read_raw_fmt(path, &fmt);
+    if (img && verbose)
+        printf("Loaded %s: %dx%d, %d channels, %d-bit raw\n", path, fmt.w, fmt.h, fmt.c, fmt.bits);
+    return to_type(img, type);
+}
+
+Image *load_image_raw(const char *path, const RawFormat *hint)
+{
+    return load_image_as(path, hint, PIXEL_U8);
+}
+
+Image *load_image(const char *path)
+{
+    return load_image_as(path, NULL, PIXEL_U8);
+}
+
+/** 解到呼叫端的 buffer：BMP 由 mmap 直接轉換、RAW 直接 fread，其餘經 stb 後複製 */
+int read_image_into(const char *path, Image *dst)
+{
+    ImageView v;
+    if (dst->type == PIXEL_U8 && bmp_open_view(path, &v))
+    {
+        int ok = v.w == dst->w && v.h == dst->h && dst->c == 3;
+        if (ok)
+            view_read_rgb(&v, 0, 0, v.w, v.h, dst->data);
+        bmp_close_view(&v);
+        return ok;
+    }
+    int w, h, c;
+    RawFormat fmt;
+    if (!stbi_info(path, &w, &h, &c) && raw_detect(path, NULL, &fmt) &&
+        (fmt.bits == 16 ? PIXEL_U16 : PIXEL_U8) == dst->type)
+        return read_raw_into(path, &fmt, dst);
+
+    Image *img = load_image_as(path, NULL, dst->type);
+    int ok = img && img->w == dst->w && img->h == dst->h && img->c == dst->c;
+    if (ok)
+        memcpy(dst->data, img->data, (size_t)img->w * img->h * img->c * pixel_size(img->type));
+    free_image(img);
+    return ok;
+}
+
+/** 只讀檔頭取得尺寸與通道數，不解碼像素 */
+int probe_image(const char *path, ImageInfo *info)
 {
     FILE *fp = fopen(path, "rb");
     if (!fp)
-        return NULL;
-    Image *img = create_image(w, h, c);
-    size_t need = (size_t)w * h * c;
-    size_t got = fread(img->data, 1, need, fp);
+        return 0;
+    fseek(fp, 0, SEEK_END);
+    info->file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    info->raw = 0;
+    int ok = stbi_info_from_file(fp, &info->w, &info->h, &info->c);
     fclose(fp);
-    if (got != need)
+    if (ok)
+        return 1;
+    RawFormat fmt;
+    if (!raw_detect(path, NULL, &fmt))
+        return 0;
+    info->raw = 1;
+    info->w = fmt.w;
+    info->h = fmt.h;
+    info->c = fmt.c;
+    return 1;
+}
+
+static unsigned int crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void)
+{
+    for (unsigned int i = 0; i < 256; ++i)
     {
-        free_image(img);
+        unsigned int c = i;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static unsigned int png_crc(unsigned int crc, const unsigned char *p, size_t n)
+{
+    pthread_once(&crc_once, crc_init);
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i)
+        crc = crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_be32(unsigned char *p, unsigned int v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+/** 在 p 寫入一個 chunk（長度、型別、資料、CRC），回傳下一個位置 */
+static unsigned char *png_chunk(unsigned char *p, const char *type, const unsigned char *data, unsigned int len)
+{
+    put_be32(p, len);
+    memcpy(p + 4, type, 4);
+    if (len)
+        memcpy(p + 8, data, len);
+    put_be32(p + 8 + len, png_crc(0, p + 4, len + 4));
+    return p + 12 + len;
+}
+
+/** stb_image_write 只寫 8-bit PNG：16-bit 自己組 chunk，壓縮沿用 stbi_zlib_compress，
+ *  每列用 Sub filter（與左邊像素的差值）；回傳的 buffer 來自 image_pool */
+static unsigned char *encode_png16(const Image *img, int *out_len)
+{
+    static const unsigned char color_type[5] = {0, 0, 4, 2, 6};
+    int c = img->c;
+    size_t stride = (size_t)img->w * c * 2;
+    size_t len = (stride + 1) * img->h;
+    unsigned char *raw = (unsigned char *)malloc(len);
+    unsigned char *line = (unsigned char *)malloc(stride);
+    const unsigned short *px = (const unsigned short *)img->data;
+    for (int y = 0; y < img->h; ++y)
+    {
+        for (size_t i = 0; i < (size_t)img->w * c; ++i)
+        {
+            unsigned short v = px[(size_t)y * img->w * c + i];
+            line[2 * i] = (unsigned char)(v >> 8);
+            line[2 * i + 1] = (unsigned char)v;
+        }
+        unsigned char *dst = &raw[(stride + 1) * y];
+        dst[0] = 1;
+        for (size_t i = 0; i < stride; ++i)
+            dst[1 + i] = (unsigned char)(line[i] - (i >= (size_t)c * 2 ? line[i - c * 2] : 0));
+    }
+    free(line);
+    int zlen;
+    unsigned char *z = stbi_zlib_compress(raw, (int)len, &zlen, stbi_write_png_compression_level);
+    free(raw);
+    if (!z)
         return NULL;
+    static const unsigned char sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    unsigned char ihdr[13];
+    put_be32(ihdr, (unsigned int)img->w);
+    put_be32(ihdr + 4, (unsigned int)img->h);
+    ihdr[8] = 16;
+    ihdr[9] = color_type[c];
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    *out_len = 8 + (12 + 13) + (12 + zlen) + 12;
+    unsigned char *png = (unsigned char *)STBIW_MALLOC(*out_len);
+    unsigned char *p = png;
+    memcpy(p, sig, 8);
+    p = png_chunk(p + 8, "IHDR", ihdr, 13);
+    p = png_chunk(p, "IDAT", z, (unsigned int)zlen);
+    png_chunk(p, "IEND", NULL, 0);
+    STBIW_FREE(z);
+    return png;
+}
+
+/** 編碼成 PNG 檔案內容：u8 交給 stb；u16 寫 16-bit PNG；f32 在這裡才量化成 16-bit */
+static unsigned char *encode_png(const Image *img, int *len)
+{
+    if (img->type == PIXEL_U16 && img->c >= 1 && img->c <= 4)
+        return encode_png16(img, len);
+    if (img->type == PIXEL_F32)
+    {
+        Image *q = convert_image(img, PIXEL_U16);
+        unsigned char *png = encode_png(q, len);
+        free_image(q);
+        return png;
     }
-    return img;
+    int c = img->c == 1 ? 1 : 3;
+    return stbi_write_png_to_mem(img->data, img->w * c, img->w, img->h, c, len);
 }
 
-void save_png(const char *path, const Image *img)
+/** 設定了 I/O 佇列（batch）時只編碼，寫檔交給佇列非同步完成；sink 在寫出前拿到編碼後的內容 */
+void save_png_to(const char *path, const Image *img, PngSink sink, void *arg)
 {
-    if (img->c == 1)
+    int len;
+    unsigned char *png = encode_png(img, &len);
+    if (!png)
+        return;
+    if (sink)
+        sink(png, (size_t)len, arg);
+    IoQueue *io = io_default();
+    if (io)
     {
-        stbi_write_png(path, img->w, img->h, 1, img->data, img->w);
+        io_write(io, path, png, (size_t)len);
+        return;
     }
-    else
+    FILE *fp = fopen(path, "wb");
+    if (fp)
     {
-        stbi_write_png(path, img->w, img->h, 3, img->data, img->w * 3);
+        fwrite(png, 1, (size_t)len, fp);
+        fclose(fp);
     }
+    STBIW_FREE(png);
+}
+
+void save_png(const char *path, const Image *img)
+{
+    save_png_to(path, img, NULL, NULL);
 }
 
 // ---------------- Point operations ----------------
@@ -101,116 +464,595 @@ static inline unsigned char clamp255(int v)
         return 255;
     return (unsigned char)v;
 }
-/** log transform */
-Image *point_log(const Image *img)
+/** 每個平行 band 約處理 64K 個位元組 */
+static int band_rows(int w, int c)
 {
-    Image *out = create_image(img->w, img->h, img->c);
-    double c = 255.0 / log(256.0);
-    for (int i = 0; i < img->w * img->h * img->c; ++i)
-    {
-        double r = img->data[i];
-        int s = (int)round(c * log(1.0 + r));
-        out->data[i] = clamp255(s);
+    int rows = 65536 / (w * c > 0 ? w * c : 1);
+    return rows > 0 ? rows : 1;
+}
+
+typedef struct
+{
+    const Image *in;
+    Image *out;
+    double k; // log 的係數或 gamma 值
+} PointBand;
+
+static inline unsigned short clamp65535(long v)
+{
+    return (unsigned short)(v < 0 ? 0 : (v > 65535 ? 65535 : v));
+}
+
+#define QUANT_U8(v) clamp255((int)round(v))
+#define QUANT_U16(v) clamp65535(lround(v))
+#define QUANT_F32(v) ((float)(v))
+
+// 點運算對每種像素型別各展開一次；MAXV 是該型別的滿刻度，曲線以 0..1 的相對值定義，
+// 因此 u16/f32 與 u8 走同一條曲線，只是量化位置不同（f32 不量化也不 clamp）
+#define DEFINE_POINT_BANDS(SUFFIX, T, MAXV, QUANT)                                  \
+    static void log_band_##SUFFIX(void *arg, int y0, int y1)                        \
+    {                                                                               \
+        PointBand *b = (PointBand *)arg;                                            \
+        const T *src = (const T *)b->in->data;                                      \
+        T *dst = (T *)b->out->data;                                                 \
+        size_t row = (size_t)b->in->w * b->in->c;                                   \
+        for (size_t i = y0 * row; i < y1 * row; ++i)                                \
+        {                                                                           \
+            double r = src[i] * (255.0 / (MAXV));                                   \
+            dst[i] = QUANT(b->k * log(1.0 + r));                                    \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    static void gamma_band_##SUFFIX(void *arg, int y0, int y1)                      \
+    {                                                                               \
+        PointBand *b = (PointBand *)arg;                                            \
+        const T *src = (const T *)b->in->data;                                      \
+        T *dst = (T *)b->out->data;                                                 \
+        size_t row = (size_t)b->in->w * b->in->c;                                   \
+        double inv = 1.0 / (MAXV);                                                  \
+        for (size_t i = y0 * row; i < y1 * row; ++i)                                \
+        {                                                                           \
+            double nr = src[i] * inv;                                               \
+            dst[i] = QUANT((MAXV) * pow(nr, b->k));                                 \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    static void negative_band_##SUFFIX(void *arg, int y0, int y1)                   \
+    {                                                                               \
+        PointBand *b = (PointBand *)arg;                                            \
+        const T *src = (const T *)b->in->data;                                      \
+        T *dst = (T *)b->out->data;                                                 \
+        size_t row = (size_t)b->in->w * b->in->c;                                   \
+        for (size_t i = y0 * row; i < y1 * row; ++i)                                \
+            dst[i] = (T)((MAXV) - src[i]);                                          \
     }
-    return out;
+
+DEFINE_POINT_BANDS(u8, unsigned char, 255, QUANT_U8)
+DEFINE_POINT_BANDS(u16, unsigned short, 65535, QUANT_U16)
+DEFINE_POINT_BANDS(f32, float, 1.0f, QUANT_F32)
+
+#define POINT_DISPATCH(NAME, type) \
+    ((type) == PIXEL_U16 ? NAME##_u16 : ((type) == PIXEL_F32 ? NAME##_f32 : NAME##_u8))
+
+/** 每種型別的滿刻度（log 係數用） */
+static double pixel_max(PixelType type)
+{
+    return type == PIXEL_U16 ? 65535.0 : (type == PIXEL_F32 ? 1.0 : 255.0);
+}
+
+/** 輸出必須與輸入同尺寸、同型別；out == img 時就地運算 */
+static int same_shape(const Image *img, const Image *out)
+{
+    return out && out->w == img->w && out->h == img->h && out->c == img->c && out->type == img->type;
+}
+
+/** 每個樣本只讀一次、寫回同一個位置，因此 out 可以就是 img */
+static int point_run(const Image *img, Image *out, RangeFn band, double k)
+{
+    if (!same_shape(img, out))
+        return 0;
+    PointBand b = {img, out, k};
+    int rows = band_rows(img->w, img->c * (int)pixel_size(img->type));
+    sched_parallel_for(sched_default(), 0, img->h, rows, band, &b);
+    return 1;
+}
+
+/** 配置輸出的點運算共用：*_into 失敗時釋放 out，回傳 NULL */
+Image *point_result(Image *out, int ok)
+{
+    if (ok)
+        return out;
+    free_image(out);
+    return NULL;
+}
+
+/** log transform：s = MAX * log(1 + r) / log(256)，r 換算成 0..255 */
+int point_log_into(const Image *img, Image *out)
+{
+    return point_run(img, out, POINT_DISPATCH(log_band, img->type), pixel_max(img->type) / log(256.0));
+}
+
+int point_gamma_into(const Image *img, Image *out, double gamma)
+{
+    return point_run(img, out, POINT_DISPATCH(gamma_band, img->type), gamma);
+}
+
+int point_negative_into(const Image *img, Image *out)
+{
+    return point_run(img, out, POINT_DISPATCH(negative_band, img->type), 0.0);
+}
+
+Image *point_log(const Image *img)
+{
+    Image *out = create_image_like(img);
+    return point_result(out, point_log_into(img, out));
 }
 
 Image *point_gamma(const Image *img, double gamma)
 {
-    Image *out = create_image(img->w, img->h, img->c);
-    double inv = 1.0 / 255.0;
-    for (int i = 0; i < img->w * img->h * img->c; ++i)
-    {
-        double nr = img->data[i] * inv;
-        int s = (int)round(255.0 * pow(nr, gamma));
-        out->data[i] = clamp255(s);
-    }
-    return out;
+    Image *out = create_image_like(img);
+    return point_result(out, point_gamma_into(img, out, gamma));
 }
 
 Image *point_negative(const Image *img)
 {
-    Image *out = create_image(img->w, img->h, img->c);
-    for (int i = 0; i < img->w * img->h * img->c; ++i)
-        out->data[i] = (unsigned char)(255 - img->data[i]);
-    return out;
+    Image *out = create_image_like(img);
+    return point_result(out, point_negative_into(img, out));
+}
+
+// ---------------- LUT ----------------
+typedef struct
+{
+    const Image *in;
+    Image *out;
+    const float *lut;          // HIST_BINS 個點，第 i 點對應直方圖的第 i 個 bin，輸出為 0..1 的相對值
+    unsigned char lut8[256];   // u8 直接查表
+} LutBand;
+
+/** 在 256 點的曲線上線性內插。位置與 hist.c 分箱的比例相同（u16 為 v/256、f32 為 v*256），
+ *  bin i 的樣本落在第 i 點之後，與 u8 的值 i 查第 i 點一致 */
+double lut_sample(const float *lut, PixelType type, double v)
+{
+    double x = type == PIXEL_U16 ? v / 256.0 : (type == PIXEL_F32 ? v * 256.0 : v);
+    if (x <= 0)
+        return lut[0];
+    if (x >= 255)
+        return lut[255];
+    int i = (int)x;
+    return lut[i] + (lut[i + 1] - lut[i]) * (x - i);
+}
+
+static void lut_band_u8(void *arg, int y0, int y1)
+{
+    LutBand *b = (LutBand *)arg;
+    const unsigned char *src = b->in->data;
+    unsigned char *dst = b->out->data;
+    size_t row = (size_t)b->in->w * b->in->c;
+    for (size_t i = y0 * row; i < y1 * row; ++i)
+        dst[i] = b->lut8[src[i]];
+}
+
+static void lut_band_u16(void *arg, int y0, int y1)
+{
+    LutBand *b = (LutBand *)arg;
+    const unsigned short *src = (const unsigned short *)b->in->data;
+    unsigned short *dst = (unsigned short *)b->out->data;
+    size_t row = (size_t)b->in->w * b->in->c;
+    for (size_t i = y0 * row; i < y1 * row; ++i)
+        dst[i] = QUANT_U16(65535.0 * lut_sample(b->lut, PIXEL_U16, src[i]));
+}
+
+static void lut_band_f32(void *arg, int y0, int y1)
+{
+    LutBand *b = (LutBand *)arg;
+    const float *src = (const float *)b->in->data;
+    float *dst = (float *)b->out->data;
+    size_t row = (size_t)b->in->w * b->in->c;
+    for (size_t i = y0 * row; i < y1 * row; ++i)
+        dst[i] = (float)lut_sample(b->lut, PIXEL_F32, src[i]);
+}
+
+/** 每個樣本經過同一條 256 點曲線；u8 先量化成位元組查表，u16 / f32 以 lut_sample 在點之間內插 */
+int point_lut_into(const Image *img, Image *out, const float *lut)
+{
+    if (!same_shape(img, out))
+        return 0;
+    LutBand b = {img, out, lut, {0}};
+    for (int v = 0; v < 256; ++v)
+        b.lut8[v] = QUANT_U8(255.0 * lut[v]);
+    int rows = band_rows(img->w, img->c * (int)pixel_size(img->type));
+    sched_parallel_for(sched_default(), 0, img->h, rows, POINT_DISPATCH(lut_band, img->type), &b);
+    return 1;
+}
+
+Image *point_lut(const Image *img, const float *lut)
+{
+    Image *out = create_image_like(img);
+    return point_result(out, point_lut_into(img, out, lut));
+}
+
+static const char *const point_op_names[] = {"log", "gamma", "negative", "equalize", "stretch", "clahe"};
+
+int point_op_known(const char *op)
+{
+    for (size_t i = 0; i < sizeof(point_op_names) / sizeof(point_op_names[0]); ++i)
+        if (strcmp(op, point_op_names[i]) == 0)
+            return 1;
+    return 0;
+}
+
+#define CLAHE_TILES 8
+
+/** 依名稱選擇點運算（log / gamma / negative / equalize / stretch / clahe），未知的名稱回傳 NULL */
+int point_by_name_into(const Image *img, Image *out, const char *op, double param)
+{
+    if (strcmp(op, "log") == 0)
+        return point_log_into(img, out);
+    if (strcmp(op, "gamma") == 0)
+        return point_gamma_into(img, out, param > 0 ? param : 1.0);
+    if (strcmp(op, "negative") == 0)
+        return point_negative_into(img, out);
+    if (strcmp(op, "equalize") == 0)
+        return point_equalize_into(img, out);
+    if (strcmp(op, "stretch") == 0)
+        return point_stretch_into(img, out, param);
+    if (strcmp(op, "clahe") == 0)
+        return point_clahe_into(img, out, CLAHE_TILES, param);
+    return 0;
+}
+
+Image *point_by_name(const Image *img, const char *op, double param)
+{
+    if (!point_op_known(op))
+        return NULL;
+    Image *out = create_image_like(img);
+    return point_result(out, point_by_name_into(img, out, op, param));
 }
 
 // ---------------- Resizing ----------------
-/** 防止resize時得到的數值超出圖片的邊界 */
-static inline unsigned char get_pixel(const Image *img, int x, int y, int c)
+/** 將一列每個像素複製 k 次（1 與 4 通道且 k 為 2 的冪次時用 SSE2 unpack 展開） */
+static void replicate_row(const unsigned char *src, unsigned char *dst, int n, int c, int k)
+{
+    int i = 0;
+#ifdef __SSE2__
+    if ((c == 1 || c == 4) && (k & (k - 1)) == 0 && k <= 16)
+    {
+        int lanes = 16 / c;
+        unsigned char tmp[256];
+        for (; i + lanes <= n; i += lanes)
+        {
+            __m128i v[16];
+            int m = 1;
+            v[0] = _mm_loadu_si128((const __m128i *)&src[(size_t)i * c]);
+            // 每次展開都讓資料量加倍
+            for (int r = 1; r < k; r *= 2)
+            {
+                for (int j = m - 1; j >= 0; --j)
+                {
+                    __m128i lo = c == 1 ? _mm_unpacklo_epi8(v[j], v[j]) : _mm_unpacklo_epi32(v[j], v[j]);
+                    __m128i hi = c == 1 ? _mm_unpackhi_epi8(v[j], v[j]) : _mm_unpackhi_epi32(v[j], v[j]);
+                    v[2 * j] = lo;
+                    v[2 * j + 1] = hi;
+                }
+                m *= 2;
+            }
+            for (int j = 0; j < m; ++j)
+                _mm_storeu_si128((__m128i *)&tmp[j * 16], v[j]);
+            memcpy(&dst[(size_t)i * k * c], tmp, (size_t)m * 16);
+        }
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        unsigned char *d = &dst[(size_t)i * k * c];
+        for (int r = 0; r < k; ++r)
+            memcpy(&d[r * c], &src[(size_t)i * c], c);
+    }
+}
+
+/** 產生一條輸出列：整數倍縮小用 strided gather，整數倍放大用位移後的複製列，其餘查表 */
+static void nearest_row(const Image *img, const unsigned char *src, unsigned char *dst, int out_w,
+                        const int *xi, GatherRowFn gather, unsigned char *rep)
 {
-    if (x < 0)
-        x = 0;
-    if (x >= img->w)
-        x = img->w - 1;
-    if (y < 0)
-        y = 0;
-    if (y >= img->h)
-        y = img->h - 1;
-    return img->data[(y * img->w + x) * img->c + c];
+    int c = img->c * (int)pixel_size(img->type); // 以位元組為單位，u16/f32 視為較寬的通道
+    if (img->w % out_w == 0)
+    {
+        int k = img->w / out_w;
+        size_t step = (size_t)k * c;
+        if (c == 1)
+        {
+            for (int x = 0; x < out_w; ++x)
+                dst[x] = src[x * step];
+        }
+        else
+        {
+            gather(src, dst, out_w, c, xi);
+        }
+        return;
+    }
+    if (out_w % img->w == 0)
+    {
+        // out[x] = R[x + k/2]，R 為每個像素重複 k 次且尾端補最後一個像素
+        int k = out_w / img->w;
+        replicate_row(src, rep, img->w, c, k);
+        for (int r = 0; r < k; ++r)
+            memcpy(&rep[((size_t)img->w * k + r) * c], &src[(size_t)(img->w - 1) * c], c);
+        memcpy(dst, &rep[(size_t)(k / 2) * c], (size_t)out_w * c);
+        return;
+    }
+    gather(src, dst, out_w, c, xi);
 }
 
 Image *resize_nearest(const Image *img, int out_w, int out_h)
 {
-    Image *out = create_image(out_w, out_h, img->c);
-    double sx = (double)img->w / out_w;
-    double sy = (double)img->h / out_h;
+    Image *out = create_image_typed(out_w, out_h, img->c, img->type);
+    int c = img->c * (int)pixel_size(img->type);
+    int *xi = (int *)malloc(sizeof(int) * out_w);
+    int *yi = (int *)malloc(sizeof(int) * out_h);
+    unsigned char *rep = NULL;
+    nearest_index_table(img->w, out_w, xi);
+    nearest_index_table(img->h, out_h, yi);
+    if (out_w % img->w == 0)
+        rep = (unsigned char *)malloc((size_t)(out_w + out_w / img->w) * c);
+
+    GatherRowFn gather = gather_row_fn(c);
+    size_t row = (size_t)out_w * c;
     for (int y = 0; y < out_h; ++y)
     {
-        int syi = (int)floor(y * sy + 0.5);
-        if (syi < 0)
-            syi = 0;
-        if (syi >= img->h)
-            syi = img->h - 1;
-        for (int x = 0; x < out_w; ++x)
-        {
-            int sxi = (int)floor(x * sx + 0.5);
-            if (sxi < 0)
-                sxi = 0;
-            if (sxi >= img->w)
-                sxi = img->w - 1;
-            memcpy(&out->data[(y * out_w + x) * img->c], &img->data[(syi * img->w + sxi) * img->c], img->c);
-        }
+        unsigned char *dst = &out->data[(size_t)y * row];
+        // 同一來源列對應的連續輸出列直接複製上一列
+        if (y > 0 && yi[y] == yi[y - 1])
+            memcpy(dst, dst - row, row);
+        else
+            nearest_row(img, &img->data[(size_t)yi[y] * img->w * c], dst, out_w, xi, gather, rep);
     }
+    free(rep);
+    free(xi);
+    free(yi);
     return out;
 }
 
+typedef struct
+{
+    const Image *in;
+    Image *out;
+    BilinearRowFn row;
+    const int *x0, *x1, *y0, *y1;
+    const double *wx, *wy;
+} BilinearBand;
+
+// u16/f32 的 bilinear row：與 kernels.c 相同的權重，只是樣本型別與量化不同
+#define DEFINE_BILINEAR_ROW(SUFFIX, T, QUANT)                                                     \
+    static void bilinear_row_##SUFFIX(const unsigned char *r0b, const unsigned char *r1b,          \
+                                      unsigned char *dstb, int out_w, int c, const int *x0,        \
+                                      const int *x1, const double *wx, double wy)                  \
+    {                                                                                             \
+        const T *r0 = (const T *)r0b, *r1 = (const T *)r1b;                                       \
+        T *dst = (T *)dstb;                                                                       \
+        for (int x = 0; x < out_w; ++x)                                                           \
+        {                                                                                         \
+            double w = wx[x];                                                                     \
+            for (int ch = 0; ch < c; ++ch)                                                        \
+            {                                                                                     \
+                double top = (1 - w) * r0[x0[x] * c + ch] + w * r0[x1[x] * c + ch];               \
+                double bot = (1 - w) * r1[x0[x] * c + ch] + w * r1[x1[x] * c + ch];               \
+                dst[x * c + ch] = QUANT((1 - wy) * top + wy * bot);                               \
+            }                                                                                     \
+        }                                                                                         \
+    }
+
+DEFINE_BILINEAR_ROW(u16, unsigned short, QUANT_U16)
+DEFINE_BILINEAR_ROW(f32, float, QUANT_F32)
+
+static void bilinear_band(void *arg, int y0, int y1)
+{
+    BilinearBand *b = (BilinearBand *)arg;
+    size_t ps = pixel_size(b->in->type);
+    size_t stride = (size_t)b->in->w * b->in->c * ps;
+    size_t out_row = (size_t)b->out->w * b->in->c * ps;
+    for (int y = y0; y < y1; ++y)
+        b->row(&b->in->data[b->y0[y] * stride], &b->in->data[b->y1[y] * stride], &b->out->data[y * out_row],
+               b->out->w, b->in->c, b->x0, b->x1, b->wx, b->wy[y]);
+}
+
 Image *resize_bilinear(const Image *img, int out_w, int out_h)
+{
+    Image *out = create_image_typed(out_w, out_h, img->c, img->type);
+    int *x0 = (int *)malloc(sizeof(int) * (out_w + out_h) * 2);
+    int *x1 = x0 + out_w;
+    int *y0 = x1 + out_w;
+    int *y1 = y0 + out_h;
+    double *wx = (double *)malloc(sizeof(double) * (out_w + out_h));
+    double *wy = wx + out_w;
+    // 每個輸出欄/列的鄰點與權重只算一次，邊界 clamp 也在此處理
+    bilinear_axis_table(img->w, out_w, x0, x1, wx);
+    bilinear_axis_table(img->h, out_h, y0, y1, wy);
+
+    BilinearRowFn row = img->type == PIXEL_U16 ? bilinear_row_u16
+                        : img->type == PIXEL_F32 ? bilinear_row_f32
+                                                 : bilinear_row_fn(img->c);
+    BilinearBand b = {img, out, row, x0, x1, y0, y1, wx, wy};
+    int rows = band_rows(out_w, img->c * (int)pixel_size(img->type));
+    sched_parallel_for(sched_default(), 0, out_h, rows, bilinear_band, &b);
+    free(x0);
+    free(wx);
+    return out;
+}
+
+/** 計算單一軸上每個輸出像素所覆蓋的來源區間與各來源像素的重疊比例（總和為 1） */
+static int build_area_weights(int src_n, int dst_n, int *first, int *count, float *weights)
+{
+    double scale = (double)src_n / dst_n;
+    int k = 0;
+    for (int i = 0; i < dst_n; ++i)
+    {
+        double s0 = i * scale;
+        double s1 = (i + 1) * scale;
+        int a = (int)floor(s0);
+        int b = (int)ceil(s1);
+        if (b > src_n)
+            b = src_n;
+        if (b <= a)
+            b = a + 1;
+        first[i] = a;
+        count[i] = b - a;
+        for (int j = a; j < b; ++j)
+        {
+            double lo = j > s0 ? j : s0;
+            double hi = j + 1 < s1 ? j + 1 : s1;
+            double ov = hi - lo;
+            weights[k++] = (float)((ov > 0 ? ov : 0) / scale);
+        }
+    }
+    return k;
+}
+
+/** 整數倍縮小：kx×ky 區塊平均（pooling），整數累加後四捨五入 */
+static void resize_area_int(const Image *img, Image *out, int kx, int ky)
+{
+    int c = img->c;
+    int ow = out->w;
+    unsigned int n = (unsigned int)(kx * ky);
+    unsigned int *acc = (unsigned int *)malloc((size_t)ow * c * sizeof(unsigned int));
+    PoolRowFn pool = pool_row_fn(c);
+    for (int y = 0; y < out->h; ++y)
+    {
+        memset(acc, 0, (size_t)ow * c * sizeof(unsigned int));
+        for (int j = 0; j < ky; ++j)
+            pool(&img->data[(size_t)(y * ky + j) * img->w * c], acc, ow, c, kx);
+        unsigned char *dst = &out->data[(size_t)y * ow * c];
+        for (int i = 0; i < ow * c; ++i)
+            dst[i] = (unsigned char)((acc[i] + n / 2) / n);
+    }
+    free(acc);
+}
+
+/** 2×2 區塊平均（寬高皆為偶數時的專用 kernel） */
+static void reduce_2x2(const Image *img, Image *out)
+{
+    int c = img->c;
+    size_t stride = (size_t)img->w * c;
+    Reduce2RowFn row = reduce2_row_fn(c);
+    for (int y = 0; y < out->h; ++y)
+    {
+        const unsigned char *r0 = &img->data[(size_t)(2 * y) * stride];
+        row(r0, r0 + stride, &out->data[(size_t)y * out->w * c], out->w, c);
+    }
+}
+
+/** area resize：以來源區域的覆蓋比例加權平均，先垂直累加整列再水平積分，複雜度 O(來源像素) */
+Image *resize_area(const Image *img, int out_w, int out_h)
 {
     Image *out = create_image(out_w, out_h, img->c);
-    double scale_x = (double)img->w / out_w;
-    double scale_y = (double)img->h / out_h;
+    if (img->w == out_w * 2 && img->h == out_h * 2)
+    {
+        reduce_2x2(img, out);
+        return out;
+    }
+    // 整數倍縮小用 32-bit 累加：kx * ky * 255 超過 UINT_MAX 時改走下面的一般路徑
+    int kx = img->w / out_w, ky = img->h / out_h;
+    if (img->w % out_w == 0 && img->h % out_h == 0 && (unsigned long long)kx * ky <= UINT_MAX / 255)
+    {
+        resize_area_int(img, out, kx, ky);
+        return out;
+    }
+
+    int c = img->c;
+    // 每個輸出像素最多覆蓋 ceil(scale)+1 個來源像素
+    size_t wx_cap = (size_t)out_w * ((size_t)ceil((double)img->w / out_w) + 2);
+    size_t wy_cap = (size_t)out_h * ((size_t)ceil((double)img->h / out_h) + 2);
+    int *fx = (int *)malloc(sizeof(int) * out_w * 2);
+    int *fy = (int *)malloc(sizeof(int) * out_h * 2);
+    float *wx = (float *)malloc(sizeof(float) * wx_cap);
+    float *wy = (float *)malloc(sizeof(float) * wy_cap);
+    float *row = (float *)malloc(sizeof(float) * img->w * c);
+    build_area_weights(img->w, out_w, fx, fx + out_w, wx);
+    build_area_weights(img->h, out_h, fy, fy + out_h, wy);
+
+    const float *wyp = wy;
     for (int y = 0; y < out_h; ++y)
     {
-        double gy = (y + 0.5) * scale_y - 0.5;
-        int y0 = (int)floor(gy);
-        int y1 = y0 + 1;
-        double wy = gy - y0;
-        for (int x = 0; x < out_w; ++x)
+        memset(row, 0, sizeof(float) * img->w * c);
+        for (int j = 0; j < fy[out_h + y]; ++j)
         {
-            double gx = (x + 0.5) * scale_x - 0.5;
-            int x0 = (int)floor(gx);
-            int x1 = x0 + 1;
-            double wx = gx - x0;
+            float w = wyp[j];
+            const unsigned char *src = &img->data[(size_t)(fy[y] + j) * img->w * c];
+            for (int i = 0; i < img->w * c; ++i)
+                row[i] += w * src[i];
+        }
+        wyp += fy[out_h + y];
 
-            for (int c = 0; c < img->c; ++c)
+        const float *wxp = wx;
+        unsigned char *dst = &out->data[(size_t)y * out_w * c];
+        for (int x = 0; x < out_w; ++x)
+        {
+            for (int ch = 0; ch < c; ++ch)
             {
-                double I00 = get_pixel(img, x0, y0, c);
-                double I10 = get_pixel(img, x1, y0, c);
-                double I01 = get_pixel(img, x0, y1, c);
-                double I11 = get_pixel(img, x1, y1, c);
-
-                double top = (1 - wx) * I00 + wx * I10;
-                double bot = (1 - wx) * I01 + wx * I11;
-                int s = (int)round((1 - wy) * top + wy * bot);
-                if (s < 0)
-                    s = 0;
-                if (s > 255)
-                    s = 255;
-                out->data[(y * out_w + x) * img->c + c] = (unsigned char)s;
+                float s = 0.0f;
+                for (int i = 0; i < fx[out_w + x]; ++i)
+                    s += wxp[i] * row[(fx[x] + i) * c + ch];
+                dst[x * c + ch] = clamp255((int)(s + 0.5f));
             }
+            wxp += fx[out_w + x];
         }
     }
+    free(fx);
+    free(fy);
+    free(wx);
+    free(wy);
+    free(row);
     return out;
 }
+
+/** 依名稱選擇縮放方法，未知的名稱回傳 NULL */
+Image *resize_by_name(const Image *img, int out_w, int out_h, const char *method)
+{
+    ResizeFilter filter;
+    if (strcmp(method, "nearest") == 0)
+        return resize_nearest(img, out_w, out_h);
+    if (strcmp(method, "bilinear") == 0)
+        return resize_bilinear(img, out_w, out_h);
+    if (img->type != PIXEL_U8)
+        return NULL;
+    if (strcmp(method, "area") == 0)
+        return resize_area(img, out_w, out_h);
+    if (resize_filter_from_name(method, &filter))
+        return resize_filter(img, out_w, out_h, filter);
+    return NULL;
+}
+
+// ---------------- Pyramid ----------------
+/** 縮小一半（奇數邊長向下取整，最小為 1） */
+Image *downsample_2x(const Image *img)
+{
+    int w = img->w / 2 > 0 ? img->w / 2 : 1;
+    int h = img->h / 2 > 0 ? img->h / 2 : 1;
+    return resize_area(img, w, h);
+}
+
+/** 由原圖逐層縮小一半，直到短邊小於 min_size；levels[0] 為原圖的複本 */
+Image **build_pyramid(const Image *img, int min_size, int *count)
+{
+    if (min_size < 1)
+        min_size = 1;
+    int n = 1;
+    for (int w = img->w, h = img->h; w / 2 >= min_size && h / 2 >= min_size; w /= 2, h /= 2)
+        ++n;
+
+    Image **levels = (Image **)malloc(sizeof(Image *) * n);
+    levels[0] = create_image(img->w, img->h, img->c);
+    memcpy(levels[0]->data, img->data, (size_t)img->w * img->h * img->c);
+    for (int i = 1; i < n; ++i)
+        levels[i] = downsample_2x(levels[i - 1]);
+    *count = n;
+    return levels;
+}
+
+void free_pyramid(Image **levels, int count)
+{
+    if (!levels)
+        return;
+    for (int i = 0; i < count; ++i)
+        free_image(levels[i]);
+    free(levels);
+}
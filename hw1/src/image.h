@@ -1,28 +1,148 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include <stddef.h>
+
+// sample type; values are 0..255 for u8, 0..65535 for u16 and nominally 0..1 for f32
+typedef enum
+{
+    PIXEL_U8,
+    PIXEL_U16,
+    PIXEL_F32
+} PixelType;
+
 typedef struct
 {
     int w, h, c;         // width, height, channels (1=gray, 3=RGB)
-    unsigned char *data; // size = w*h*c
+    unsigned char *data; // size = w*h*c samples of pixel_size(type) bytes
+    PixelType type;      // PIXEL_U8 unless created with create_image_typed
 } Image;
 
+#define PLANAR_MAX_CHANNELS 4
+
+// planar (SoA) layout: plane[i] points into data, each plane is w*h bytes
+typedef struct
+{
+    int w, h, c;
+    unsigned char *plane[PLANAR_MAX_CHANNELS];
+    unsigned char *data;
+} PlanarImage;
+
+// per-plane operation: gets a 1-channel view, returns a new 1-channel image
+typedef Image *(*PlaneOp)(const Image *plane, const void *arg);
+
+// geometry of a headerless RAW file; zero fields are unknown
+typedef struct
+{
+    int w, h, c;
+    int bits;       // 8 or 16 bits per sample
+    int big_endian; // byte order of 16-bit samples
+    long offset;    // bytes to skip before the pixel data
+} RawFormat;
+
+// header-only metadata, filled without decoding pixels
+typedef struct
+{
+    int w, h, c;
+    int raw;        // 1 if the geometry was inferred from a headerless RAW file
+    long file_size; // bytes on disk
+} ImageInfo;
+
+typedef enum
+{
+    FILTER_BICUBIC,
+    FILTER_LANCZOS3,
+    FILTER_MITCHELL
+} ResizeFilter;
+
 Image *read_image(const char *path); // jpg/png via stb
-Image *read_raw(const char *path, int w, int h, int c);
-void save_png(const char *path, const Image *img);
+Image *read_image_as(const char *path, PixelType type); // stbi_load_16 / stbi_loadf for u16 / f32
+Image *read_raw(const char *path, int w, int h, int c); // 8-bit; read_raw_fmt for other layouts
+Image *load_image(const char *path);                             // read_image, falling back to RAW detection
+Image *load_image_raw(const char *path, const RawFormat *hint); // same, with RAW geometry hints (may be NULL)
+Image *load_image_as(const char *path, const RawFormat *hint, PixelType type);
+// decode into dst->data, which must already have the file's w/h/c (see probe_image);
+// BMP and RAW are read in place, other formats are copied out of a pooled stb buffer
+int read_image_into(const char *path, Image *dst);
 
-// point operations
+// RAW geometry (raw.c): hint > --raw default > <path>.hdr sidecar > file-size inference
+int raw_detect(const char *path, const RawFormat *hint, RawFormat *out);
+int raw_detect_size(const char *path, long size, const RawFormat *hint, RawFormat *out); // size of the file in bytes
+Image *read_raw_fmt(const char *path, const RawFormat *fmt); // 16-bit files give PIXEL_U16
+int read_raw_into(const char *path, const RawFormat *fmt, Image *dst); // 0 if dst does not match fmt
+int raw_decode_into(const unsigned char *buf, size_t len, const RawFormat *fmt, Image *dst); // file bytes in memory
+int parse_raw_spec(const char *spec, RawFormat *fmt); // "<w>x<h>[x<c>][@<bits>][be]"
+void set_raw_default(const RawFormat *fmt);
+int probe_image(const char *path, ImageInfo *info); // stbi_info or RAW size sniffing; 1 on success
+void save_png(const char *path, const Image *img); // u16 and f32 are written as 16-bit PNG
+// like save_png; sink (if set) sees the encoded file before it is written, e.g. to cache it
+typedef void (*PngSink)(const unsigned char *png, size_t len, void *arg);
+void save_png_to(const char *path, const Image *img, PngSink sink, void *arg);
+
+// point operations (every pixel type; the output keeps the input type).
+// The *_into forms write to out, which must have img's w/h/c/type, and return 0
+// otherwise; out may be img itself (in place), so a caller that no longer needs
+// the input keeps one buffer instead of two. The allocating forms call the
+// *_into form on create_image_like(img) and return point_result(out, ok).
+Image *point_result(Image *out, int ok); // out if ok, otherwise frees out and returns NULL
 Image *point_log(const Image *img);
 Image *point_gamma(const Image *img, double gamma);
 Image *point_negative(const Image *img);
+Image *point_lut(const Image *img, const float *lut); // lut[i]: 0..1 output for histogram bin i (see hist.h)
+// lut at sample value v of the given type, on the histogram's bin scale and
+// interpolated between bins (the u16/f32 paths of point_lut and point_clahe)
+double lut_sample(const float *lut, PixelType type, double v);
+// histogram-driven (hist.c): one statistics pass, then one point_lut pass
+Image *point_equalize(const Image *img);
+Image *point_stretch(const Image *img, double percent); // clip `percent`% at each end, stretch the rest
+// contrast-limited adaptive equalization over a tiles x tiles grid; clip is the
+// bin limit as a multiple of the average bin count (<= 0 means 2)
+Image *point_clahe(const Image *img, int tiles, double clip);
+Image *point_by_name(const Image *img, const char *op, double param); // NULL if unknown
+
+int point_log_into(const Image *img, Image *out);
+int point_gamma_into(const Image *img, Image *out, double gamma);
+int point_negative_into(const Image *img, Image *out);
+int point_lut_into(const Image *img, Image *out, const float *lut);
+int point_equalize_into(const Image *img, Image *out);
+int point_stretch_into(const Image *img, Image *out, double percent);
+int point_clahe_into(const Image *img, Image *out, int tiles, double clip);
+int point_by_name_into(const Image *img, Image *out, const char *op, double param); // 0 if unknown
+int point_op_known(const char *op);
 
-// resizing
+// resizing; nearest and bilinear take every pixel type, the rest need PIXEL_U8
 Image *resize_nearest(const Image *img, int out_w, int out_h);
 Image *resize_bilinear(const Image *img, int out_w, int out_h);
+Image *resize_area(const Image *img, int out_w, int out_h); // box average over the source footprint
+
+// separable filter resizing (resample.c); per-axis weights are cached by (src, dst, filter)
+Image *resize_filter(const Image *img, int out_w, int out_h, ResizeFilter f);
+int resize_filter_from_name(const char *name, ResizeFilter *out); // 1 if name is a known filter
+void resize_filter_cache_clear(void);
+Image *resize_by_name(const Image *img, int out_w, int out_h, const char *method); // NULL if unknown or unsupported for the type
+
+// pyramid: each level is a 2x area reduction of the previous one
+Image *downsample_2x(const Image *img);
+Image **build_pyramid(const Image *img, int min_size, int *count);
+void free_pyramid(Image **levels, int count);
+
+// planar layout (planar.c)
+PlanarImage *create_planar(int w, int h, int c);
+void free_planar(PlanarImage *p);
+PlanarImage *to_planar(const Image *img);  // deinterleave
+Image *from_planar(const PlanarImage *p);  // interleave
+int from_planar_into(const PlanarImage *p, Image *img); // interleave into an 8-bit image of the same shape
+Image planar_view(const PlanarImage *p, int ch);
+PlanarImage *planar_apply(const PlanarImage *src, PlaneOp op, const void *arg, int parallel); // NULL if any plane fails
 
 // utils
-Image *create_image(int w, int h, int c);
+Image *create_image(int w, int h, int c); // PIXEL_U8; data comes from image_pool() (pool.h), 64-byte aligned
+Image *create_image_typed(int w, int h, int c, PixelType type);
+Image *create_image_like(const Image *img); // same w/h/c/type, contents undefined
+Image *convert_image(const Image *img, PixelType type); // rescale (and round/clamp when narrowing)
+size_t pixel_size(PixelType type);
+int pixel_type_from_name(const char *name, PixelType *out); // "8", "16" or "f32"
 void free_image(Image *img);
-const char *file_stem(const char *path);
+void set_verbose(int on); // print a line per loaded image (default on)
 
 #endif
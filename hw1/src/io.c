@@ -0,0 +1,602 @@
+// Asynchronous file I/O.
+// 請求（讀整個檔 / 寫整個檔）放進待辦串列，由背景執行緒處理：有 io_uring 時單一執行緒
+// 一次送出一批 READ/WRITE 並收割完成事件（直接用 syscall，不需要 liburing），
+// 否則由數個執行緒各自做阻塞式 read/write。
+
+#define _GNU_SOURCE
+#include "io.h"
+#include "pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && !defined(NO_IO_URING)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#define IO_THREADS_N 4
+#define IO_RING_DEPTH 32
+
+enum
+{
+    REQ_READ,
+    REQ_WRITE
+};
+
+enum
+{
+    ST_LISTED,   // 在預讀清單中，尚未送出
+    ST_QUEUED,   // 已送給背景執行緒
+    ST_DONE,
+    ST_FAILED
+};
+
+typedef struct IoReq
+{
+    int kind;
+    int state;
+    int claimed;
+    char *path;
+    unsigned char *data;
+    size_t len, done;
+    int fd;
+    struct IoReq *next; // 待辦串列
+} IoReq;
+
+#ifdef HAVE_IO_URING
+typedef struct
+{
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_len, cq_len, sqe_len;
+    unsigned entries;
+} Ring;
+#endif
+
+struct IoQueue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work; // 待辦串列有新請求
+    pthread_cond_t done; // 有請求完成
+    IoReq *todo_head, *todo_tail;
+    IoReq **list; // 預讀清單（依序）
+    int nlist, cap_list, next_list;
+    int window, ahead; // ahead = 已送出但尚未被 take 的預讀數
+    int pending_writes;
+    int stop;
+    pthread_t *threads;
+    int nthreads;
+    IoStats st;
+#ifdef HAVE_IO_URING
+    Ring ring;
+    int uring;
+#endif
+};
+
+static IoQueue *default_io;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** 放進待辦串列（需持有 lock） */
+static void enqueue(IoQueue *q, IoReq *r)
+{
+    r->state = ST_QUEUED;
+    r->next = NULL;
+    if (q->todo_tail)
+        q->todo_tail->next = r;
+    else
+        q->todo_head = r;
+    q->todo_tail = r;
+    pthread_cond_signal(&q->work);
+}
+
+static IoReq *dequeue(IoQueue *q)
+{
+    IoReq *r = q->todo_head;
+    if (r)
+    {
+        q->todo_head = r->next;
+        if (!q->todo_head)
+            q->todo_tail = NULL;
+    }
+    return r;
+}
+
+/** 補滿預讀視窗（需持有 lock） */
+static void top_up(IoQueue *q)
+{
+    while (q->ahead < q->window && q->next_list < q->nlist)
+    {
+        IoReq *r = q->list[q->next_list++];
+        if (r->state != ST_LISTED)
+            continue;
+        q->ahead++;
+        enqueue(q, r);
+    }
+}
+
+/** 開檔並準備 buffer；讀取時依檔案大小從 pool 配置 */
+static int req_open(IoReq *r)
+{
+    if (r->kind == REQ_READ)
+    {
+        r->fd = open(r->path, O_RDONLY);
+        struct stat st;
+        if (r->fd < 0 || fstat(r->fd, &st) != 0)
+            return 0;
+        r->len = (size_t)st.st_size;
+        r->data = (unsigned char *)pool_alloc(image_pool(), r->len ? r->len : 1);
+    }
+    else
+    {
+        r->fd = open(r->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    r->done = 0;
+    return r->fd >= 0;
+}
+
+/** 請求結束：關檔、更新統計並喚醒等待者（需持有 lock） */
+static void req_finish(IoQueue *q, IoReq *r, int ok)
+{
+    if (r->fd >= 0)
+        close(r->fd);
+    r->fd = -1;
+    r->state = ok ? ST_DONE : ST_FAILED;
+    if (r->kind == REQ_READ)
+    {
+        q->st.reads++;
+        if (ok)
+            q->st.bytes_read += r->len;
+    }
+    else
+    {
+        q->st.writes++;
+        if (ok)
+            q->st.bytes_written += r->len;
+        else
+            fprintf(stderr, "Cannot write %s\n", r->path);
+        pool_free(image_pool(), r->data);
+        r->data = NULL;
+        free(r->path);
+        free(r);
+        q->pending_writes--;
+    }
+    if (!ok)
+        q->st.failed++;
+    pthread_cond_broadcast(&q->done);
+}
+
+/** 阻塞式完成一個請求（thread-pool 後端與同步讀取共用） */
+static int req_blocking(IoReq *r)
+{
+    if (!req_open(r))
+        return 0;
+    while (r->done < r->len)
+    {
+        ssize_t n = r->kind == REQ_READ ? pread(r->fd, r->data + r->done, r->len - r->done, (off_t)r->done)
+                                        : pwrite(r->fd, r->data + r->done, r->len - r->done, (off_t)r->done);
+        if (n <= 0)
+            return 0;
+        r->done += (size_t)n;
+    }
+    return 1;
+}
+
+static void *thread_worker(void *arg)
+{
+    IoQueue *q = (IoQueue *)arg;
+    pthread_mutex_lock(&q->lock);
+    for (;;)
+    {
+        IoReq *r = dequeue(q);
+        if (!r)
+        {
+            if (q->stop)
+                break;
+            pthread_cond_wait(&q->work, &q->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&q->lock);
+        int ok = req_blocking(r);
+        pthread_mutex_lock(&q->lock);
+        req_finish(q, r, ok);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+#ifdef HAVE_IO_URING
+static int ring_setup(Ring *rg, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(rg, 0, sizeof(*rg));
+    rg->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (rg->fd < 0)
+        return 0;
+    rg->entries = p.sq_entries;
+    rg->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    rg->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        rg->sq_len = rg->cq_len = rg->sq_len > rg->cq_len ? rg->sq_len : rg->cq_len;
+    rg->sq_map = mmap(NULL, rg->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rg->fd, IORING_OFF_SQ_RING);
+    if (rg->sq_map == MAP_FAILED)
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        rg->cq_map = rg->sq_map;
+    else
+        rg->cq_map = mmap(NULL, rg->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rg->fd,
+                          IORING_OFF_CQ_RING);
+    if (rg->cq_map == MAP_FAILED)
+        goto fail;
+    rg->sqe_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    rg->sqes = (struct io_uring_sqe *)mmap(NULL, rg->sqe_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                           rg->fd, IORING_OFF_SQES);
+    if (rg->sqes == MAP_FAILED)
+        goto fail;
+    unsigned char *sq = (unsigned char *)rg->sq_map, *cq = (unsigned char *)rg->cq_map;
+    rg->sq_head = (unsigned *)(sq + p.sq_off.head);
+    rg->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    rg->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    rg->sq_array = (unsigned *)(sq + p.sq_off.array);
+    rg->cq_head = (unsigned *)(cq + p.cq_off.head);
+    rg->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    rg->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    rg->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 1;
+fail:
+    // 例如 seccomp 或 io_uring_disabled 擋掉 mmap：交給 thread-pool 後端
+    if (rg->sq_map && rg->sq_map != MAP_FAILED)
+        munmap(rg->sq_map, rg->sq_len);
+    if (rg->cq_map && rg->cq_map != MAP_FAILED && rg->cq_map != rg->sq_map)
+        munmap(rg->cq_map, rg->cq_len);
+    close(rg->fd);
+    return 0;
+}
+
+static void ring_teardown(Ring *rg)
+{
+    munmap(rg->sqes, rg->sqe_len);
+    if (rg->cq_map != rg->sq_map)
+        munmap(rg->cq_map, rg->cq_len);
+    munmap(rg->sq_map, rg->sq_len);
+    close(rg->fd);
+}
+
+/** 把請求剩下的部分放進 SQ（呼叫端保證 SQ 有空位） */
+static void ring_push(Ring *rg, IoReq *r)
+{
+    unsigned tail = *rg->sq_tail;
+    unsigned idx = tail & *rg->sq_mask;
+    struct io_uring_sqe *sqe = &rg->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = r->kind == REQ_READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = r->fd;
+    sqe->addr = (unsigned long)(r->data + r->done);
+    sqe->len = (unsigned)(r->len - r->done);
+    sqe->off = r->done;
+    sqe->user_data = (unsigned long)r;
+    rg->sq_array[idx] = idx;
+    __atomic_store_n(rg->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/** 單一執行緒擁有 ring：一次拿一批待辦請求送出，再收割完成事件；短讀寫會重新送出剩餘部分 */
+static void *ring_worker(void *arg)
+{
+    IoQueue *q = (IoQueue *)arg;
+    Ring *rg = &q->ring;
+    unsigned inring = 0;  // 已放進 SQ 但尚未完成
+    unsigned unsent = 0;  // 已放進 SQ 但 kernel 還沒取走
+    IoReq *retry = NULL; // 短讀寫，下一輪重新送出
+    for (;;)
+    {
+        while (retry && inring < rg->entries)
+        {
+            IoReq *r = retry;
+            retry = r->next;
+            ring_push(rg, r);
+            inring++;
+            unsent++;
+        }
+        pthread_mutex_lock(&q->lock);
+        while (!q->todo_head && !q->stop && inring == 0)
+            pthread_cond_wait(&q->work, &q->lock);
+        if (!q->todo_head && q->stop && inring == 0)
+        {
+            pthread_mutex_unlock(&q->lock);
+            break;
+        }
+        IoReq *batch = NULL, **tail = &batch;
+        for (unsigned n = inring; q->todo_head && n < rg->entries; ++n)
+        {
+            IoReq *r = dequeue(q);
+            r->next = NULL;
+            *tail = r;
+            tail = &r->next;
+        }
+        pthread_mutex_unlock(&q->lock);
+
+        // open/fstat 仍是同步的，讀寫本身交給 ring
+        for (IoReq *r = batch, *next; r; r = next)
+        {
+            next = r->next;
+            int opened = req_open(r);
+            if (opened && r->len > 0)
+            {
+                ring_push(rg, r);
+                inring++;
+                unsent++;
+                continue;
+            }
+            pthread_mutex_lock(&q->lock);
+            req_finish(q, r, opened);
+            pthread_mutex_unlock(&q->lock);
+        }
+        if (inring == 0)
+            continue;
+        long ret = syscall(__NR_io_uring_enter, rg->fd, unsent, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0)
+            continue; // EINTR 等：下一輪再送
+        unsent -= (unsigned)ret < unsent ? (unsigned)ret : unsent;
+        unsigned head = *rg->cq_head;
+        while (head != __atomic_load_n(rg->cq_tail, __ATOMIC_ACQUIRE))
+        {
+            struct io_uring_cqe *cqe = &rg->cqes[head & *rg->cq_mask];
+            IoReq *r = (IoReq *)(unsigned long)cqe->user_data;
+            int res = cqe->res;
+            head++;
+            inring--;
+            if (res > 0 && r->done + (size_t)res < r->len)
+            {
+                r->done += (size_t)res;
+                r->next = retry;
+                retry = r;
+                continue;
+            }
+            if (res > 0)
+                r->done += (size_t)res;
+            pthread_mutex_lock(&q->lock);
+            req_finish(q, r, res >= 0 && r->done == r->len);
+            pthread_mutex_unlock(&q->lock);
+        }
+        __atomic_store_n(rg->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+#endif
+
+IoQueue *io_create(IoBackend backend, int window)
+{
+    IoQueue *q = (IoQueue *)calloc(1, sizeof(IoQueue));
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->work, NULL);
+    pthread_cond_init(&q->done, NULL);
+    q->window = window > 0 ? window : 1;
+    q->st.backend = "threads";
+#ifdef HAVE_IO_URING
+    if (backend == IO_AUTO && ring_setup(&q->ring, IO_RING_DEPTH))
+    {
+        q->uring = 1;
+        q->st.backend = "io_uring";
+        q->nthreads = 1;
+        q->threads = (pthread_t *)malloc(sizeof(pthread_t));
+        pthread_create(&q->threads[0], NULL, ring_worker, q);
+        return q;
+    }
+#else
+    (void)backend;
+#endif
+    q->nthreads = IO_THREADS_N;
+    q->threads = (pthread_t *)malloc(sizeof(pthread_t) * q->nthreads);
+    for (int i = 0; i < q->nthreads; ++i)
+        pthread_create(&q->threads[i], NULL, thread_worker, q);
+    return q;
+}
+
+void io_destroy(IoQueue *q)
+{
+    if (!q)
+        return;
+    io_flush(q);
+    pthread_mutex_lock(&q->lock);
+    q->stop = 1;
+    pthread_cond_broadcast(&q->work);
+    pthread_mutex_unlock(&q->lock);
+    for (int i = 0; i < q->nthreads; ++i)
+        pthread_join(q->threads[i], NULL);
+#ifdef HAVE_IO_URING
+    if (q->uring)
+        ring_teardown(&q->ring);
+#endif
+    // 沒有被 take 的預讀
+    for (int i = 0; i < q->nlist; ++i)
+    {
+        IoReq *r = q->list[i];
+        if (!r->claimed)
+            pool_free(image_pool(), r->data);
+        free(r->path);
+        free(r);
+    }
+    if (default_io == q)
+        default_io = NULL;
+    free(q->list);
+    free(q->threads);
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->work);
+    pthread_cond_destroy(&q->done);
+    free(q);
+}
+
+static IoReq *new_req(int kind, const char *path)
+{
+    IoReq *r = (IoReq *)calloc(1, sizeof(IoReq));
+    r->kind = kind;
+    r->path = strdup(path);
+    r->fd = -1;
+    return r;
+}
+
+void io_prefetch(IoQueue *q, const char *path)
+{
+    IoReq *r = new_req(REQ_READ, path);
+    r->state = ST_LISTED;
+    pthread_mutex_lock(&q->lock);
+    if (q->nlist == q->cap_list)
+    {
+        q->cap_list = q->cap_list ? q->cap_list * 2 : 64;
+        q->list = (IoReq **)realloc(q->list, sizeof(IoReq *) * q->cap_list);
+    }
+    q->list[q->nlist++] = r;
+    top_up(q);
+    pthread_mutex_unlock(&q->lock);
+}
+
+int io_take(IoQueue *q, const char *path, unsigned char **data, size_t *len)
+{
+    pthread_mutex_lock(&q->lock);
+    IoReq *r = NULL;
+    for (int i = 0; i < q->nlist && !r; ++i)
+        if (!q->list[i]->claimed && strcmp(q->list[i]->path, path) == 0)
+            r = q->list[i];
+    if (!r)
+    {
+        // 不在預讀清單：在呼叫端同步讀取，時間算進 I/O 等待
+        pthread_mutex_unlock(&q->lock);
+        IoReq tmp;
+        memset(&tmp, 0, sizeof(tmp));
+        tmp.kind = REQ_READ;
+        tmp.fd = -1;
+        tmp.path = (char *)path;
+        double t0 = now_s();
+        int ok = req_blocking(&tmp);
+        if (tmp.fd >= 0)
+            close(tmp.fd);
+        pthread_mutex_lock(&q->lock);
+        q->st.wait_s += now_s() - t0;
+        q->st.reads++;
+        if (ok)
+            q->st.bytes_read += tmp.len;
+        else
+            q->st.failed++;
+        pthread_mutex_unlock(&q->lock);
+        if (!ok)
+        {
+            pool_free(image_pool(), tmp.data);
+            return 0;
+        }
+        *data = tmp.data;
+        *len = tmp.len;
+        return 1;
+    }
+    r->claimed = 1;
+    if (r->state == ST_LISTED)
+        enqueue(q, r); // 還沒輪到：插隊送出
+    else
+        q->ahead--;
+    if (r->state == ST_DONE)
+        q->st.prefetch_ready++;
+    double t0 = now_s();
+    while (r->state == ST_QUEUED)
+        pthread_cond_wait(&q->done, &q->lock);
+    q->st.wait_s += now_s() - t0;
+    top_up(q);
+    int ok = r->state == ST_DONE;
+    *data = r->data;
+    *len = r->len;
+    r->data = NULL;
+    pthread_mutex_unlock(&q->lock);
+    if (!ok)
+    {
+        pool_free(image_pool(), *data);
+        *data = NULL;
+    }
+    return ok;
+}
+
+/** 預讀後卻不需要的檔案（例如結果快取命中）：尚未送出就取消，否則等讀完後釋放 */
+void io_drop(IoQueue *q, const char *path)
+{
+    pthread_mutex_lock(&q->lock);
+    IoReq *r = NULL;
+    for (int i = 0; i < q->nlist && !r; ++i)
+        if (!q->list[i]->claimed && strcmp(q->list[i]->path, path) == 0)
+            r = q->list[i];
+    if (r)
+    {
+        r->claimed = 1;
+        if (r->state == ST_LISTED)
+        {
+            r->state = ST_DONE; // 從未送出，不佔預讀視窗
+        }
+        else
+        {
+            q->ahead--;
+            while (r->state == ST_QUEUED)
+                pthread_cond_wait(&q->done, &q->lock);
+            pool_free(image_pool(), r->data);
+            r->data = NULL;
+        }
+        top_up(q);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+void io_write(IoQueue *q, const char *path, unsigned char *data, size_t len)
+{
+    IoReq *r = new_req(REQ_WRITE, path);
+    r->data = data;
+    r->len = len;
+    pthread_mutex_lock(&q->lock);
+    q->pending_writes++;
+    enqueue(q, r);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void io_flush(IoQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    double t0 = now_s();
+    while (q->pending_writes > 0)
+        pthread_cond_wait(&q->done, &q->lock);
+    q->st.wait_s += now_s() - t0;
+    pthread_mutex_unlock(&q->lock);
+}
+
+void io_stats(IoQueue *q, IoStats *out)
+{
+    pthread_mutex_lock(&q->lock);
+    *out = q->st;
+    out->unclaimed = 0;
+    for (int i = 0; i < q->nlist; ++i)
+        out->unclaimed += !q->list[i]->claimed;
+    pthread_mutex_unlock(&q->lock);
+}
+
+void io_set_default(IoQueue *q)
+{
+    default_io = q;
+}
+
+IoQueue *io_default(void)
+{
+    return default_io;
+}
@@ -0,0 +1,49 @@
+#ifndef IO_H
+#define IO_H
+
+#include <stddef.h>
+
+// Asynchronous whole-file I/O for batch runs (io.c).
+// Inputs listed with io_prefetch are read ahead, at most `window` files that
+// nobody has claimed yet; io_take hands a file's bytes to the job that needs
+// it. io_write queues an encoded output and returns at once. Requests go to an
+// io_uring instance when the kernel provides one, otherwise to a small pool of
+// blocking I/O threads.
+
+typedef struct IoQueue IoQueue;
+
+typedef enum
+{
+    IO_AUTO,    // io_uring if available, threads otherwise
+    IO_THREADS, // force the thread-pool backend
+} IoBackend;
+
+typedef struct
+{
+    const char *backend; // "io_uring" or "threads"
+    long reads, writes;
+    long prefetch_ready; // io_take found the read already finished
+    long failed;
+    long unclaimed; // prefetched files nobody has taken or dropped (each pins a window slot)
+    size_t bytes_read, bytes_written;
+    double wait_s; // time callers spent blocked in io_take / io_flush, summed over threads
+} IoStats;
+
+IoQueue *io_create(IoBackend backend, int window);
+void io_destroy(IoQueue *q); // flushes pending writes
+
+void io_prefetch(IoQueue *q, const char *path); // append to the read-ahead list
+// bytes of path (a prefetched copy if one is listed, else read now); *data comes
+// from image_pool() and is released with pool_free; 0 if the file cannot be read
+int io_take(IoQueue *q, const char *path, unsigned char **data, size_t *len);
+void io_drop(IoQueue *q, const char *path); // a listed file is not needed after all: cancel or release it
+void io_write(IoQueue *q, const char *path, unsigned char *data, size_t len); // takes data (pool buffer)
+void io_flush(IoQueue *q);                                                    // wait for queued writes
+
+void io_stats(IoQueue *q, IoStats *out);
+
+// queue used by load_image / save_png when set (NULL = plain blocking I/O)
+void io_set_default(IoQueue *q);
+IoQueue *io_default(void);
+
+#endif
@@ -0,0 +1,179 @@
+// Channel-count specialized row kernels.
+// 每個 kernel 以巨集展開成 C=1/3/4 三個版本，通道數是編譯期常數，
+// 最內層迴圈可以完全展開；其他通道數用執行期的 c 走通用版本。
+
+#include "kernels.h"
+#include <math.h>
+
+#define DEFINE_KERNELS(SUFFIX, C)                                                                  \
+    static void bilinear_row_##SUFFIX(const unsigned char *r0, const unsigned char *r1,             \
+                                      unsigned char *dst, int out_w, int c, const int *x0,          \
+                                      const int *x1, const double *wx, double wy)                   \
+    {                                                                                              \
+        (void)c;                                                                                   \
+        for (int x = 0; x < out_w; ++x)                                                            \
+        {                                                                                          \
+            const unsigned char *a = &r0[x0[x] * (C)], *b = &r0[x1[x] * (C)];                      \
+            const unsigned char *d = &r1[x0[x] * (C)], *e = &r1[x1[x] * (C)];                      \
+            double w = wx[x];                                                                      \
+            for (int ch = 0; ch < (C); ++ch)                                                       \
+            {                                                                                      \
+                double top = (1 - w) * a[ch] + w * b[ch];                                          \
+                double bot = (1 - w) * d[ch] + w * e[ch];                                          \
+                int s = (int)round((1 - wy) * top + wy * bot);                                     \
+                dst[x * (C) + ch] = (unsigned char)(s < 0 ? 0 : (s > 255 ? 255 : s));              \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void gather_row_##SUFFIX(const unsigned char *src, unsigned char *dst, int out_w, int c, \
+                                    const int *idx)                                                \
+    {                                                                                              \
+        (void)c;                                                                                   \
+        for (int x = 0; x < out_w; ++x)                                                            \
+            for (int ch = 0; ch < (C); ++ch)                                                       \
+                dst[x * (C) + ch] = src[idx[x] * (C) + ch];                                        \
+    }                                                                                              \
+                                                                                                   \
+    static void pool_row_##SUFFIX(const unsigned char *src, unsigned int *acc, int out_w, int c,    \
+                                  int k)                                                           \
+    {                                                                                              \
+        (void)c;                                                                                   \
+        for (int x = 0; x < out_w; ++x)                                                            \
+        {                                                                                          \
+            const unsigned char *p = &src[(long)x * k * (C)];                                      \
+            unsigned int s[(C) > 0 ? (C) : 1] = {0};                                               \
+            for (int i = 0; i < k; ++i)                                                            \
+                for (int ch = 0; ch < (C); ++ch)                                                   \
+                    s[ch] += p[i * (C) + ch];                                                      \
+            for (int ch = 0; ch < (C); ++ch)                                                       \
+                acc[x * (C) + ch] += s[ch];                                                        \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void reduce2_row_##SUFFIX(const unsigned char *r0, const unsigned char *r1,              \
+                                     unsigned char *dst, int out_w, int c)                         \
+    {                                                                                              \
+        (void)c;                                                                                   \
+        for (int x = 0; x < out_w; ++x)                                                            \
+        {                                                                                          \
+            const unsigned char *a = &r0[x * 2 * (C)], *b = &r1[x * 2 * (C)];                      \
+            for (int ch = 0; ch < (C); ++ch)                                                       \
+                dst[x * (C) + ch] =                                                                \
+                    (unsigned char)((a[ch] + a[(C) + ch] + b[ch] + b[(C) + ch] + 2) >> 2);         \
+        }                                                                                          \
+    }
+
+DEFINE_KERNELS(c1, 1)
+DEFINE_KERNELS(c3, 3)
+DEFINE_KERNELS(c4, 4)
+
+// 通用版本：通道數在執行期才知道
+static void bilinear_row_cn(const unsigned char *r0, const unsigned char *r1, unsigned char *dst,
+                            int out_w, int c, const int *x0, const int *x1, const double *wx, double wy)
+{
+    for (int x = 0; x < out_w; ++x)
+    {
+        double w = wx[x];
+        for (int ch = 0; ch < c; ++ch)
+        {
+            double top = (1 - w) * r0[x0[x] * c + ch] + w * r0[x1[x] * c + ch];
+            double bot = (1 - w) * r1[x0[x] * c + ch] + w * r1[x1[x] * c + ch];
+            int s = (int)round((1 - wy) * top + wy * bot);
+            dst[x * c + ch] = (unsigned char)(s < 0 ? 0 : (s > 255 ? 255 : s));
+        }
+    }
+}
+
+static void gather_row_cn(const unsigned char *src, unsigned char *dst, int out_w, int c, const int *idx)
+{
+    for (int x = 0; x < out_w; ++x)
+        for (int ch = 0; ch < c; ++ch)
+            dst[x * c + ch] = src[idx[x] * c + ch];
+}
+
+static void pool_row_cn(const unsigned char *src, unsigned int *acc, int out_w, int c, int k)
+{
+    for (int x = 0; x < out_w; ++x)
+    {
+        const unsigned char *p = &src[(long)x * k * c];
+        for (int i = 0; i < k; ++i)
+            for (int ch = 0; ch < c; ++ch)
+                acc[x * c + ch] += p[i * c + ch];
+    }
+}
+
+static void reduce2_row_cn(const unsigned char *r0, const unsigned char *r1, unsigned char *dst, int out_w, int c)
+{
+    for (int x = 0; x < out_w; ++x)
+    {
+        const unsigned char *a = &r0[x * 2 * c], *b = &r1[x * 2 * c];
+        for (int ch = 0; ch < c; ++ch)
+            dst[x * c + ch] = (unsigned char)((a[ch] + a[c + ch] + b[ch] + b[c + ch] + 2) >> 2);
+    }
+}
+
+/** 最近鄰的來源索引表：與逐像素 floor(i*scale+0.5) 相同，但每個軸只算一次 */
+void nearest_index_table(int src_n, int dst_n, int *idx)
+{
+    if (dst_n % src_n == 0)
+    {
+        // 整數倍放大：floor((i + k/2) / k)，純整數運算
+        int k = dst_n / src_n;
+        for (int i = 0; i < dst_n; ++i)
+        {
+            int s = (i + k / 2) / k;
+            idx[i] = s < src_n ? s : src_n - 1;
+        }
+        return;
+    }
+    if (src_n % dst_n == 0)
+    {
+        int k = src_n / dst_n;
+        for (int i = 0; i < dst_n; ++i)
+            idx[i] = i * k;
+        return;
+    }
+    double scale = (double)src_n / dst_n;
+    for (int i = 0; i < dst_n; ++i)
+    {
+        int s = (int)floor(i * scale + 0.5);
+        if (s < 0)
+            s = 0;
+        if (s >= src_n)
+            s = src_n - 1;
+        idx[i] = s;
+    }
+}
+
+/** 雙線性的鄰點表：i0/i1 為 clamp 後的來源索引，w 為 i1 的權重 */
+void bilinear_axis_table(int src_n, int dst_n, int *i0, int *i1, double *w)
+{
+    double scale = (double)src_n / dst_n;
+    for (int i = 0; i < dst_n; ++i)
+    {
+        double g = (i + 0.5) * scale - 0.5;
+        int f = (int)floor(g);
+        w[i] = g - f;
+        i0[i] = f < 0 ? 0 : (f >= src_n ? src_n - 1 : f);
+        i1[i] = f + 1 < 0 ? 0 : (f + 1 >= src_n ? src_n - 1 : f + 1);
+    }
+}
+
+#define DISPATCH(NAME)         \
+    switch (c)                 \
+    {                          \
+    case 1:                    \
+        return NAME##_c1;      \
+    case 3:                    \
+        return NAME##_c3;      \
+    case 4:                    \
+        return NAME##_c4;      \
+    default:                   \
+        return NAME##_cn;      \
+    }
+
+BilinearRowFn bilinear_row_fn(int c) { DISPATCH(bilinear_row) }
+GatherRowFn gather_row_fn(int c) { DISPATCH(gather_row) }
+PoolRowFn pool_row_fn(int c) { DISPATCH(pool_row) }
+Reduce2RowFn reduce2_row_fn(int c) { DISPATCH(reduce2_row) }
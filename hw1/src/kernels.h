@@ -0,0 +1,27 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+// Row kernels specialized at compile time for 1, 3 and 4 channels (kernels.c).
+// Callers pick a variant once per image with the *_fn(c) getters; any other
+// channel count falls back to a generic loop over c.
+
+// bilinear: x0/x1 are clamped source columns, wx the weight of x1
+typedef void (*BilinearRowFn)(const unsigned char *r0, const unsigned char *r1, unsigned char *dst,
+                              int out_w, int c, const int *x0, const int *x1, const double *wx, double wy);
+// nearest: dst[x] = src[idx[x]]
+typedef void (*GatherRowFn)(const unsigned char *src, unsigned char *dst, int out_w, int c, const int *idx);
+// area pooling: acc[x] += sum of k source pixels starting at x*k
+typedef void (*PoolRowFn)(const unsigned char *src, unsigned int *acc, int out_w, int c, int k);
+// 2x2 average of two source rows
+typedef void (*Reduce2RowFn)(const unsigned char *r0, const unsigned char *r1, unsigned char *dst, int out_w, int c);
+
+// per-axis source index tables shared by the resize paths
+void nearest_index_table(int src_n, int dst_n, int *idx);
+void bilinear_axis_table(int src_n, int dst_n, int *i0, int *i1, double *w);
+
+BilinearRowFn bilinear_row_fn(int c);
+GatherRowFn gather_row_fn(int c);
+PoolRowFn pool_row_fn(int c);
+Reduce2RowFn reduce2_row_fn(int c);
+
+#endif
@@ -9,39 +9,104 @@
 //   ./dip_tool resize F16.jpg 512 512 128 128 nearest
 //   ./dip_tool resize F16.jpg 512 512 32 32 bilinear
 //   ./dip_tool resize F16.jpg 32 32 512 512 bilinear
-// Output files are saved under ./out/
+//   ./dip_tool resize F16.jpg 512 512 32 32 area
+//   ./dip_tool resize F16.jpg 512 512 1024 512 lanczos3
+//   ./dip_tool pyramid F16.jpg 32 4
+//   ./dip_tool batch jobs.txt 8
+//   ./dip_tool info data/
+//   ./dip_tool compare data/F16.bmp out/C/F16_resize_32x32_to_512x512_bilinear.png json
+//   ./dip_tool point_op data/ gamma 2.2
+//   ./dip_tool resize 'data/*.bmp' 512 512 128 128 area
+//   ./dip_tool --raw 640x480@16 info scan.raw
+//   ./dip_tool --depth 16 point_op scan.raw gamma 0.5
+// Output files are saved under ./out/ (or the directory given with --out <dir>)
+// RAW geometry comes from --raw, a <file>.hdr sidecar, or the file size
 
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <math.h>
+#include <pthread.h>
+#include <time.h>
 #include "image.h"
+#include "tile.h"
+#include "sched.h"
+#include "pipeline.h"
+#include "path.h"
+#include "pool.h"
+#include "io.h"
+#include "cache.h"
+#include "hist.h"
+#include "metrics.h"
 
-static void ensure_out_dir(void)
+static void prepare_out_dir(const char *subdir)
 {
-#ifdef _WIN32
-    system("if not exist out mkdir out");
-    system("if not exist out\\A mkdir out\\A");
-    system("if not exist out\\B mkdir out\\B");
-    system("if not exist out\\C mkdir out\\C");
-#else
-    if (system("mkdir -p out/A out/B out/C") != 0)
-    {
-        fprintf(stderr, "warning: failed to create out directory\n");
-    }
-#endif
+    if (ensure_out_dir(subdir) != 0)
+        fprintf(stderr, "warning: failed to create %s/%s\n", out_root(), subdir);
+}
+
+static PixelType pixel_type = PIXEL_U8; // --depth 指定的讀檔型別
+static const char *raw_spec = "";        // --raw 的原字串，併入快取 key
+
+/** 運算描述再加上影響讀檔結果的設定（--depth、--raw）作為快取 key；未啟用快取時回傳 0 */
+static int result_key(const char *path, CacheKey *key, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static int result_key(const char *path, CacheKey *key, const char *fmt, ...)
+{
+    if (!cache_enabled())
+        return 0;
+    char desc[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(desc, sizeof(desc), fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= sizeof(desc))
+        return 0;
+    snprintf(desc + n, sizeof(desc) - n, " depth=%d raw=%s", (int)pixel_type, raw_spec);
+    return cache_key(path, desc, key);
+}
+
+/** ROI 併入輸出檔名與快取 key：_roi_<w>x<h>+<x>+<y>，沒有 ROI 時為空字串 */
+static void roi_suffix(const Rect *roi, char *buf, size_t n)
+{
+    if (roi)
+        snprintf(buf, n, "_roi_%dx%d+%d+%d", roi->w, roi->h, roi->x, roi->y);
+    else
+        buf[0] = '\0';
+}
+
+/** ROI 至少要與 w x h 的輸出重疊，否則 tiled 運算沒有任何 tile 可算 */
+static int roi_inside(const Rect *roi, int w, int h)
+{
+    if (!roi || (roi->x < w && roi->y < h))
+        return 1;
+    fprintf(stderr, "ROI %dx%d+%d+%d is outside the %dx%d result\n", roi->w, roi->h, roi->x, roi->y, w, h);
+    return 0;
+}
+
+/** save_png_to 的 sink：編碼好的結果直接存進快取 */
+static void store_result(const unsigned char *png, size_t len, void *key)
+{
+    cache_store((const CacheKey *)key, png, len);
+}
+
+/** 輸入不會被讀取時（命中快取、參數錯誤）：batch 預讀的內容直接丟掉，釋放預讀視窗 */
+static void skip_input(const char *path)
+{
+    IoQueue *io = io_default();
+    if (io)
+        io_drop(io, path);
 }
 
-static void save_center_10x10_into_png(const char *outp, const Image *img)
+static void save_center_10x10_into_png(const char *outp, const Image *img, int print)
 {
     int cx = img->w / 2, cy = img->h / 2;
     int x0 = cx - 5, y0 = cy - 5;
-    printf("Center 10x10:\n");
-    Image small;
-    small.w = 10;
-    small.h = 10;
-    small.c = img->c;
-    small.data = (unsigned char *)malloc(10 * 10 * img->c);
+    size_t px = (size_t)img->c * pixel_size(img->type);
+    if (print)
+        printf("Center 10x10:\n");
+    Image *small = create_image_typed(10, 10, img->c, img->type);
     for (int y = 0; y < 10; ++y)
     {
         for (int x = 0; x < 10; ++x)
@@ -50,155 +115,806 @@ static void save_center_10x10_into_png(const char *outp, const Image *img)
             xi = xi < 0 ? 0 : (xi >= img->w ? img->w - 1 : xi);
             yi = yi < 0 ? 0 : (yi >= img->h ? img->h - 1 : yi);
             size_t src_idx = (size_t)yi * img->w + xi;
-            size_t dst_idx = (size_t)y * small.w + x;
-            memcpy(&small.data[dst_idx * img->c], &img->data[src_idx * img->c], img->c);
-            printf("%3d ", (int)img->data[src_idx * img->c]);
+            size_t dst_idx = (size_t)y * small->w + x;
+            memcpy(&small->data[dst_idx * px], &img->data[src_idx * px], px);
+            if (!print)
+                continue;
+            if (img->type == PIXEL_U16)
+                printf("%5d ", (int)((const unsigned short *)img->data)[src_idx * img->c]);
+            else if (img->type == PIXEL_F32)
+                printf("%.4f ", ((const float *)img->data)[src_idx * img->c]);
+            else
+                printf("%3d ", (int)img->data[src_idx * img->c]);
         }
-        printf("\n");
+        if (print)
+            printf("\n");
+    }
+    save_png(outp, small);
+    free_image(small);
+}
+
+// ---------------- Multi-input (directory / glob) ----------------
+/** 目錄或 glob 輸入：列舉一次後交給 decode → compute → encode pipeline */
+static void run_many(const char *arg, PipelineOp op, const void *op_arg, PipelineNameFn name, const void *name_arg)
+{
+    char **paths = NULL;
+    int n = collect_inputs(arg, &paths);
+    if (n <= 0)
+    {
+        fprintf(stderr, "No input files match %s\n", arg);
+        return;
     }
-    save_png(outp, &small);
-    free(small.data);
+    PipelineConfig cfg;
+    pipeline_default_config(&cfg);
+    cfg.op = op;
+    cfg.op_arg = op_arg;
+    cfg.name = name;
+    cfg.name_arg = name_arg;
+    cfg.type = pixel_type;
+    PipelineStats st;
+    set_verbose(0);
+    pipeline_run((const char *const *)paths, n, &cfg, &st);
+    pipeline_print_stats(&st);
+    pool_print_stats(image_pool());
+    free_inputs(paths, n);
+}
+
+// ---------------- read_image ----------------
+/** 輸出路徑過長時回傳 0，呼叫端略過寫檔 */
+static int path_ok(size_t len, size_t n, const char *src)
+{
+    if (len < n)
+        return 1;
+    fprintf(stderr, "Output path too long for %s\n", src);
+    return 0;
+}
+
+static int read_image_out_path(const char *path, char *buf, size_t n)
+{
+    return path_ok(out_path(buf, n, "A", path, "%s", ""), n, path);
+}
+
+static int read_image_center_path(const char *path, char *buf, size_t n)
+{
+    return path_ok(out_path(buf, n, "A", path, "_center"), n, path);
+}
+
+static int read_image_name(const char *in_path, int in_w, int in_h, const Image *res,
+                           char *buf, size_t n, const void *arg)
+{
+    (void)in_w;
+    (void)in_h;
+    (void)arg;
+    // 在 encode 階段順便寫出中心 10×10 小圖（多檔模式不印表格）
+    char center[OUT_PATH_MAX];
+    if (read_image_center_path(in_path, center, sizeof(center)))
+        save_center_10x10_into_png(center, res, 0);
+    return read_image_out_path(in_path, buf, n);
 }
 
 static void cmd_read_image(const char *path)
 {
-    ensure_out_dir();
-    Image *img = read_image(path);
-    if (!img)
-        img = read_raw(path, 512, 512, 1);
+    prepare_out_dir("A");
+    if (is_multi_input(path))
+    {
+        run_many(path, NULL, NULL, read_image_name, NULL);
+        return;
+    }
+    Image *img = load_image_as(path, NULL, pixel_type);
     if (!img)
     {
         fprintf(stderr, "Failed to read RAW\n");
         return;
     }
 
-    char outp[256];
-    snprintf(outp, sizeof(outp), "out/A/%s.png", file_stem(path));
-    save_png(outp, img);
-    printf("Saved image %s\n", outp);
+    char outp[OUT_PATH_MAX];
+    if (read_image_out_path(path, outp, sizeof(outp)))
+    {
+        save_png(outp, img);
+        printf("Saved image %s\n", outp);
+    }
 
-    char outp_center[256];
-    snprintf(outp_center, sizeof(outp_center), "out/A/%s_center.png", file_stem(path));
-    save_center_10x10_into_png(outp_center, img);
-    printf("Saved center %s\n", outp);
+    char outp_center[OUT_PATH_MAX];
+    if (read_image_center_path(path, outp_center, sizeof(outp_center)))
+    {
+        save_center_10x10_into_png(outp_center, img, 1);
+        printf("Saved center %s\n", outp);
+    }
     free_image(img);
 }
 
-static void cmd_point_op(const char *path, const char *op, double param)
+// ---------------- point_op ----------------
+typedef struct
 {
-    ensure_out_dir();
-    Image *img = read_image(path);
-    if (!img)
-        img = read_raw(path, 512, 512, 1);
+    const char *op;
+    double param;
+    const char *layout; // "", "planar" 或 "tiled"
+    const Rect *roi;    // tiled 時只計算這個範圍（NULL = 整張）
+} PointArgs;
+
+/** param 為 NaN 表示 gamma auto：由影像的直方圖決定 */
+static int auto_param(const PointArgs *a)
+{
+    return strcmp(a->op, "gamma") == 0 && isnan(a->param);
+}
+
+/** 逐樣本的運算（不依賴直方圖）才有 planar / tiled 版本：各通道平面或各 tile 分別運算 */
+static int point_local_ok(const PointArgs *a)
+{
+    return !auto_param(a) &&
+           (strcmp(a->op, "log") == 0 || strcmp(a->op, "gamma") == 0 || strcmp(a->op, "negative") == 0);
+}
+
+/** 拆成平面、每個平面就地運算（平面內仍以 row band 平行），再交錯寫回 img */
+static int point_apply_planar(Image *img, const PointArgs *a)
+{
+    PlanarImage *p = to_planar(img);
+    int ok = p != NULL;
+    for (int ch = 0; ok && ch < img->c; ++ch)
+    {
+        Image v = planar_view(p, ch);
+        ok = point_by_name_into(&v, &v, a->op, a->param);
+    }
+    ok = ok && from_planar_into(p, img);
+    free_planar(p);
+    return ok;
+}
+
+static Image *point_tile_op(const Image *tile, const void *arg)
+{
+    const PointArgs *a = (const PointArgs *)arg;
+    return point_by_name(tile, a->op, a->param);
+}
+
+/** 各 tile 平行運算；有 ROI 時只計算與它重疊的 tile，結果為 ROI 的範圍 */
+static Image *point_tiled(TiledImage *src, const PointArgs *a)
+{
+    if (!roi_inside(a->roi, src->w, src->h))
+        return NULL;
+    TiledImage *dst = tiled_point_op(src, point_tile_op, a, a->roi);
+    Image *res = dst ? tiled_read_rect(dst, a->roi) : NULL;
+    free_tiled(dst);
+    return res;
+}
+
+/** 就地運算：輸入讀完後就不再需要，輸出直接寫回同一個 buffer */
+static int point_apply(Image *img, const PointArgs *a, int print)
+{
+    if (strcmp(a->layout, "planar") == 0 && img->type == PIXEL_U8 && img->c > 1)
+        return point_apply_planar(img, a);
+    if (!auto_param(a))
+        return point_by_name_into(img, img, a->op, a->param);
+    double g;
+    int ok = point_auto_gamma_into(img, img, &g);
+    if (print)
+        printf("auto gamma %.2f\n", g);
+    return ok;
+}
+
+static int point_out_path(const char *path, const PointArgs *a, char *buf, size_t n)
+{
+    char roi[64];
+    roi_suffix(a->roi, roi, sizeof(roi));
+    if (auto_param(a))
+        return path_ok(out_path(buf, n, "B", path, "_gamma_auto%s", roi), n, path);
+    if (strcmp(a->op, "gamma") == 0)
+        return path_ok(out_path(buf, n, "B", path, "_gamma_%.2f%s", a->param, roi), n, path);
+    if (strcmp(a->op, "stretch") == 0 || strcmp(a->op, "clahe") == 0)
+        return path_ok(out_path(buf, n, "B", path, "_%s_%.1f%s", a->op, a->param, roi), n, path);
+    return path_ok(out_path(buf, n, "B", path, "_%s%s", a->op, roi), n, path);
+}
+
+static Image *point_many_op(Image *img, const void *arg)
+{
+    const PointArgs *a = (const PointArgs *)arg;
+    if (strcmp(a->layout, "tiled") == 0)
+    {
+        TiledImage *src = tiled_from_image(img, TILE_DEFAULT);
+        Image *res = point_tiled(src, a);
+        free_tiled(src);
+        return res;
+    }
+    return point_apply(img, a, 0) ? img : NULL;
+}
+
+static int point_many_name(const char *in_path, int in_w, int in_h, const Image *res,
+                           char *buf, size_t n, const void *arg)
+{
+    (void)in_w;
+    (void)in_h;
+    (void)res;
+    return point_out_path(in_path, (const PointArgs *)arg, buf, n);
+}
+
+static void cmd_point_op(const char *path, const char *op, double param, const char *layout, const Rect *roi)
+{
+    prepare_out_dir("B");
+    if (strcmp(op, "gamma") == 0 && param <= 0)
+        param = 1.0;
+    PointArgs args = {op, param, layout, roi};
+    int tiled = strcmp(layout, "tiled") == 0;
+    if (!point_op_known(op))
+    {
+        fprintf(stderr, "Unknown op: %s\n", op);
+        skip_input(path);
+        return;
+    }
+    if (layout[0] && !point_local_ok(&args))
+    {
+        fprintf(stderr, "%s layout supports log|gamma <value>|negative\n", layout);
+        skip_input(path);
+        return;
+    }
+    if (tiled && pixel_type != PIXEL_U8)
+    {
+        fprintf(stderr, "tiled layout needs 8-bit input\n");
+        skip_input(path);
+        return;
+    }
+    if (is_multi_input(path))
+    {
+        run_many(path, point_many_op, &args, point_many_name, &args);
+        return;
+    }
+
+    char outp[OUT_PATH_MAX];
+    int outp_ok = point_out_path(path, &args, outp, sizeof(outp));
+    CacheKey key;
+    char roi_key[64];
+    roi_suffix(roi, roi_key, sizeof(roi_key));
+    int keyed = outp_ok && result_key(path, &key, "point_op %s %.17g%s", op, param, roi_key);
+    if (keyed && cache_fetch(&key, outp))
+    {
+        skip_input(path);
+        printf("Saved %s (cached)\n", outp);
+        return;
+    }
+
+    if (tiled)
+    {
+        // tile 直接從檔案讀取（BMP / 8-bit RAW 只讀 ROI 用到的 tile），不使用預讀的內容
+        skip_input(path);
+        TiledImage *src = tiled_open(path, NULL, TILE_DEFAULT);
+        if (!src)
+        {
+            fprintf(stderr, "Cannot read %s\n", path);
+            return;
+        }
+        Image *res = point_tiled(src, &args);
+        free_tiled(src);
+        if (res && outp_ok)
+        {
+            save_png_to(outp, res, keyed ? store_result : NULL, &key);
+            printf("Saved %s\n", outp);
+        }
+        free_image(res);
+        return;
+    }
+
+    Image *img = load_image_as(path, NULL, pixel_type);
     if (!img)
     {
         fprintf(stderr, "Cannot read %s\n", path);
         return;
     }
 
+    if (point_apply(img, &args, 1) && outp_ok)
+    {
+        save_png_to(outp, img, keyed ? store_result : NULL, &key);
+        printf("Saved %s\n", outp);
+    }
+    free_image(img);
+}
+
+// ---------------- resize ----------------
+typedef struct
+{
+    int w, h;
+    const char *method;
+    const char *layout;
+    const Rect *roi; // tiled 時只計算輸出的這個範圍（NULL = 整張）
+} ResizeArgs;
+
+static Image *resize_plane(const Image *plane, const void *arg)
+{
+    const ResizeArgs *a = (const ResizeArgs *)arg;
+    return resize_by_name(plane, a->w, a->h, a->method);
+}
+
+/** 以 tile 為單位平行計算輸出；有 ROI 時只計算與它重疊的輸出 tile（也只讀入它們需要的來源 tile），
+ *  結果為 ROI 的範圍 */
+static Image *resize_tiled(TiledImage *src, const ResizeArgs *a)
+{
+    if (!roi_inside(a->roi, a->w, a->h))
+        return NULL;
+    TiledImage *dst = tiled_resize(src, a->w, a->h, a->method, a->roi);
+    if (!dst)
+    {
+        fprintf(stderr, "tiled resize supports nearest|bilinear\n");
+        return NULL;
+    }
+    Image *res = tiled_read_rect(dst, a->roi);
+    free_tiled(dst);
+    return res;
+}
+
+/** 依 layout（planar / tiled / 一般交錯）執行縮放 */
+static Image *resize_with_layout(Image *img, const void *arg)
+{
+    const ResizeArgs *a = (const ResizeArgs *)arg;
     Image *res = NULL;
-    if (strcmp(op, "log") == 0)
+    if (img->type != PIXEL_U8 && a->layout[0])
+        return NULL; // planar / tiled 只有 8-bit 版本
+    if (strcmp(a->layout, "planar") == 0 && img->c > 1 && img->c <= PLANAR_MAX_CHANNELS)
     {
-        res = point_log(img);
+        // 拆成平面後各通道平行縮放，再交錯回去
+        PlanarImage *src = to_planar(img);
+        PlanarImage *dst = planar_apply(src, resize_plane, a, 1);
+        if (dst)
+            res = from_planar(dst);
+        free_planar(src);
+        free_planar(dst);
     }
-    else if (strcmp(op, "gamma") == 0)
+    else if (strcmp(a->layout, "tiled") == 0)
+    {
+        TiledImage *src = tiled_from_image(img, TILE_DEFAULT);
+        res = resize_tiled(src, a);
+        free_tiled(src);
+    }
+    else
     {
-        if (param <= 0)
-            param = 1.0;
-        res = point_gamma(img, param);
+        res = resize_by_name(img, a->w, a->h, a->method);
     }
-    else if (strcmp(op, "negative") == 0)
+    return res;
+}
+
+static int resize_out_path(const char *path, int in_w, int in_h, const ResizeArgs *a, char *buf, size_t n)
+{
+    char roi[64];
+    roi_suffix(a->roi, roi, sizeof(roi));
+    return path_ok(out_path(buf, n, "C", path, "_resize_%dx%d_to_%dx%d_%s%s", in_w, in_h, a->w, a->h, a->method, roi),
+                   n, path);
+}
+
+static int resize_many_name(const char *in_path, int in_w, int in_h, const Image *res,
+                            char *buf, size_t n, const void *arg)
+{
+    (void)res;
+    return resize_out_path(in_path, in_w, in_h, (const ResizeArgs *)arg, buf, n);
+}
+
+/** 不解碼取得輸入尺寸（命中快取時用來組輸出檔名）；RAW 與讀檔時一樣依提示推測 */
+static int input_size(const char *path, const RawFormat *hint, int *w, int *h)
+{
+    ImageInfo info;
+    RawFormat fmt;
+    if (!probe_image(path, &info))
+        return 0;
+    if (info.raw)
     {
-        res = point_negative(img);
+        if (!raw_detect(path, hint, &fmt))
+            return 0;
+        info.w = fmt.w;
+        info.h = fmt.h;
+    }
+    *w = info.w;
+    *h = info.h;
+    return 1;
+}
+
+static void cmd_resize(const char *path, int in_w, int in_h,
+                       int out_w, int out_h,
+                       const char *method, const char *layout, const Rect *roi)
+{
+    prepare_out_dir("C");
+    ResizeArgs args = {out_w, out_h, method, layout, roi};
+    if (is_multi_input(path))
+    {
+        run_many(path, resize_with_layout, &args, resize_many_name, &args);
+        return;
+    }
+    // <in_w> <in_h> 只在 RAW 檔時當作尺寸提示；有檔頭的格式以檔頭為準
+    RawFormat hint = {in_w, in_h, 0, 0, 0, 0};
+    char outp[OUT_PATH_MAX], roi_key[64];
+    CacheKey key;
+    int src_w = 0, src_h = 0;
+    roi_suffix(roi, roi_key, sizeof(roi_key));
+    int keyed = cache_enabled() && input_size(path, &hint, &src_w, &src_h) &&
+                resize_out_path(path, src_w, src_h, &args, outp, sizeof(outp)) &&
+                result_key(path, &key, "resize %dx%d %dx%d %s %s%s", in_w, in_h, out_w, out_h, method, layout,
+                           roi_key);
+    if (keyed && cache_fetch(&key, outp))
+    {
+        skip_input(path);
+        printf("Saved %s (cached)\n", outp);
+        return;
+    }
+
+    int w, h;
+    Image *res;
+    if (strcmp(layout, "tiled") == 0 && pixel_type == PIXEL_U8)
+    {
+        // tile 直接從檔案讀取（BMP / 8-bit RAW 只讀 ROI 用到的來源 tile），不使用預讀的內容
+        skip_input(path);
+        TiledImage *src = tiled_open(path, &hint, TILE_DEFAULT);
+        if (!src)
+        {
+            fprintf(stderr, "Cannot read %s\n", path);
+            return;
+        }
+        w = src->w;
+        h = src->h;
+        res = resize_tiled(src, &args);
+        free_tiled(src);
     }
     else
     {
-        fprintf(stderr, "Unknown op: %s\n", op);
+        Image *img = load_image_as(path, &hint, pixel_type);
+        if (!img)
+        {
+            fprintf(stderr, "Cannot read %s\n", path);
+            return;
+        }
+        w = img->w;
+        h = img->h;
+        res = resize_with_layout(img, &args);
+        if (!res && img->type != PIXEL_U8)
+            fprintf(stderr, "Method %s needs 8-bit input (only nearest|bilinear support --depth 16|f32)\n", method);
+        else if (!res)
+            fprintf(stderr, "Unknown method: %s\n", method);
+        free_image(img);
     }
     if (res)
     {
-        char outp[256];
-        if (strcmp(op, "gamma") == 0)
-            snprintf(outp, sizeof(outp), "out/B/%s_gamma_%.2f.png", file_stem(path), param);
-        else
-            snprintf(outp, sizeof(outp), "out/B/%s_%s.png", file_stem(path), op);
-        save_png(outp, res);
+        if (resize_out_path(path, w, h, &args, outp, sizeof(outp)))
+        {
+            // 檔頭推測的尺寸與實際解碼不同時（檔名不同）不存進快取
+            int store = keyed && src_w == w && src_h == h;
+            save_png_to(outp, res, store ? store_result : NULL, &key);
+            printf("Saved %s\n", outp);
+        }
         free_image(res);
+    }
+}
+
+typedef struct
+{
+    Image **levels;
+    int count;
+    const char *path;
+    int next; // 下一個待寫出的 level
+    pthread_mutex_t lock;
+} PyramidJob;
+
+/** encode worker：輪流領取尚未寫出的 level */
+static void *pyramid_encode_worker(void *arg)
+{
+    PyramidJob *job = (PyramidJob *)arg;
+    for (;;)
+    {
+        pthread_mutex_lock(&job->lock);
+        int i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->count)
+            break;
+        const Image *lv = job->levels[i];
+        char outp[OUT_PATH_MAX];
+        if (!path_ok(out_path(outp, sizeof(outp), "C", job->path, "_pyramid_%dx%d", lv->w, lv->h),
+                     sizeof(outp), job->path))
+            continue;
+        save_png(outp, lv);
         printf("Saved %s\n", outp);
     }
-    free_image(img);
+    return NULL;
 }
 
-static void cmd_resize(const char *path,
-                       int out_w, int out_h,
-                       const char *method)
+static void cmd_pyramid(const char *path, int min_size, int jobs)
 {
-    ensure_out_dir();
-    Image *img = read_image(path);
-    if (!img)
-        img = read_raw(path, 512, 512, 1);
+    prepare_out_dir("C");
+    Image *img = load_image(path);
     if (!img)
     {
         fprintf(stderr, "Cannot read %s\n", path);
         return;
     }
 
-    Image *res = NULL;
-    if (strcmp(method, "nearest") == 0)
+    int count = 0;
+    Image **levels = build_pyramid(img, min_size, &count);
+    free_image(img);
+
+    PyramidJob job = {levels, count, path, 0, PTHREAD_MUTEX_INITIALIZER};
+    if (jobs < 1)
+        jobs = 1;
+    if (jobs > count)
+        jobs = count;
+    pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) * jobs);
+    for (int i = 1; i < jobs; ++i)
+        pthread_create(&tids[i], NULL, pyramid_encode_worker, &job);
+    pyramid_encode_worker(&job);
+    for (int i = 1; i < jobs; ++i)
+        pthread_join(tids[i], NULL);
+    free(tids);
+    free_pyramid(levels, count);
+}
+
+// ---------------- info ----------------
+typedef struct
+{
+    char **paths;
+    ImageInfo *infos;
+    int *ok;
+} InfoJob;
+
+static void info_band(void *arg, int begin, int end)
+{
+    InfoJob *job = (InfoJob *)arg;
+    for (int i = begin; i < end; ++i)
+        job->ok[i] = probe_image(job->paths[i], &job->infos[i]);
+}
+
+/** argv[2..] 中的目錄與 glob 展開成檔案清單（依參數順序） */
+static char **collect_args(int argc, char **argv, int *count)
+{
+    int n = 0, cap = 16;
+    char **paths = (char **)malloc(sizeof(char *) * cap);
+    for (int i = 2; i < argc; ++i)
     {
-        res = resize_nearest(img, out_w, out_h);
+        char **found = NULL;
+        int k = 1;
+        if (is_multi_input(argv[i]))
+            k = collect_inputs(argv[i], &found);
+        for (int j = 0; j < k; ++j)
+        {
+            if (n == cap)
+            {
+                cap *= 2;
+                paths = (char **)realloc(paths, sizeof(char *) * cap);
+            }
+            paths[n++] = strdup(found ? found[j] : argv[i]);
+        }
+        free_inputs(found, k > 0 ? k : 0);
     }
-    else if (strcmp(method, "bilinear") == 0)
+    *count = n;
+    return paths;
+}
+
+/** 平行讀取檔頭並依輸入順序印出尺寸資訊，不解碼像素 */
+static int cmd_info(int argc, char **argv)
+{
+    int n;
+    char **paths = collect_args(argc, argv, &n);
+
+    InfoJob job = {paths, (ImageInfo *)malloc(sizeof(ImageInfo) * (n ? n : 1)), (int *)malloc(sizeof(int) * (n ? n : 1))};
+    sched_parallel_for(sched_default(), 0, n, 8, info_band, &job);
+    int failed = 0;
+    for (int i = 0; i < n; ++i)
     {
-        res = resize_bilinear(img, out_w, out_h);
+        const ImageInfo *in = &job.infos[i];
+        if (job.ok[i])
+            printf("%s: %dx%d, %d channels, %s, %ld bytes\n", paths[i], in->w, in->h, in->c,
+                   in->raw ? "raw" : "encoded", in->file_size);
+        else
+        {
+            printf("%s: unknown format\n", paths[i]);
+            failed = 1;
+        }
     }
-    else
+    free_inputs(paths, n);
+    free(job.infos);
+    free(job.ok);
+    return failed;
+}
+
+// ---------------- stats ----------------
+/** 直方圖 bin 換回樣本的數值範圍（u8 即 bin 本身） */
+static double bin_level(PixelType type, int bin)
+{
+    return type == PIXEL_U16 ? bin * 257.0 : (type == PIXEL_F32 ? bin / 255.0 : bin);
+}
+
+/** 每個通道的 min / max / mean / std 與 1%、50%、99% 分位數，以及建議的 gamma */
+static int cmd_stats(int argc, char **argv)
+{
+    int n;
+    char **paths = collect_args(argc, argv, &n);
+    int failed = 0;
+    set_verbose(0);
+    for (int i = 0; i < n; ++i)
     {
-        fprintf(stderr, "Unknown method: %s\n", method);
+        Image *img = load_image_as(paths[i], NULL, pixel_type);
+        ImageStats st;
+        if (!img || !image_stats(img, &st))
+        {
+            printf("%s: cannot read\n", paths[i]);
+            free_image(img);
+            failed = 1;
+            continue;
+        }
+        const char *prec = img->type == PIXEL_F32 ? "%s%.4f" : "%s%.0f";
+        printf("%s: %dx%d, %d channels\n", paths[i], img->w, img->h, img->c);
+        for (int k = 0; k < st.c; ++k)
+        {
+            printf("  ch%d: min ", k);
+            printf(prec, "", st.min[k]);
+            printf(prec, " max ", st.max[k]);
+            printf(img->type == PIXEL_F32 ? " mean %.4f std %.4f" : " mean %.2f std %.2f", st.mean[k], st.std[k]);
+            printf(prec, " p1 ", bin_level(st.type, hist_percentile(st.bins[k], st.n, 0.01)));
+            printf(prec, " p50 ", bin_level(st.type, hist_percentile(st.bins[k], st.n, 0.50)));
+            printf(prec, " p99 ", bin_level(st.type, hist_percentile(st.bins[k], st.n, 0.99)));
+            printf("\n");
+        }
+        printf("  auto gamma %.2f\n", auto_gamma(&st));
+        free_image(img);
     }
-    if (res)
+    free_inputs(paths, n);
+    return failed;
+}
+
+// ---------------- compare ----------------
+/** PSNR 為無限大（完全相同）時 JSON 沒有對應的數值，輸出 null */
+static void json_number(char *buf, size_t n, const char *fmt, double v)
+{
+    if (isfinite(v))
+        snprintf(buf, n, fmt, v);
+    else
+        snprintf(buf, n, "null");
+}
+
+/** 輸出加上引號的 JSON 字串：引號、反斜線與控制字元要跳脫 */
+static void json_string(const char *str)
+{
+    putchar('"');
+    for (const unsigned char *p = (const unsigned char *)str; *p; ++p)
     {
-        char outp[256];
-        snprintf(outp, sizeof(outp), "out/C/%s_resize_%dx%d_to_%dx%d_%s.png",
-                 file_stem(path), img->w, img->h, out_w, out_h, method);
-        save_png(outp, res);
-        free_image(res);
-        printf("Saved %s\n", outp);
+        if (*p == '"' || *p == '\\')
+            printf("\\%c", *p);
+        else if (*p == '\n')
+            printf("\\n");
+        else if (*p == '\t')
+            printf("\\t");
+        else if (*p < 0x20 || *p == 0x7f)
+            printf("\\u%04x", *p);
+        else
+            putchar(*p);
     }
-    free_image(img);
+    putchar('"');
 }
 
-int main(int argc, char **argv)
+/** argv[2] 是參考影像，其後每個檔案（或目錄、glob）都與它比較；最後一個參數為 json 時
+ *  每個結果輸出一行 JSON（batch 中多個 compare 的輸出可直接串接） */
+static int cmd_compare(int argc, char **argv)
 {
-    if (argc < 3)
+    int json = argc >= 5 && strcmp(argv[argc - 1], "json") == 0;
+    if (json)
+        argc--;
+    int n;
+    char **paths = collect_args(argc, argv, &n);
+    int failed = 0;
+    set_verbose(0);
+    Image *ref = n >= 2 ? load_image_as(paths[0], NULL, pixel_type) : NULL;
+    if (!ref)
     {
-        fprintf(stderr,
-                "Usage:\n"
-                "  %s read_raw <path.raw>\n"
-                "  %s read_jpg <path.jpg>\n"
-                "  %s point_op <path.(jpg/png)> <log|gamma|negative> [gamma]\n"
-                "  %s resize <path.(raw/jpg/png)> <in_w> <in_h> <out_w> <out_h> <nearest|bilinear>\n",
-                argv[0], argv[0], argv[0], argv[0]);
+        if (n >= 2)
+            fprintf(stderr, "%s: cannot read\n", paths[0]);
+        else
+        {
+            fprintf(stderr, "compare needs a reference and at least one image\n");
+            if (n == 1)
+                skip_input(paths[0]);
+        }
+        free_inputs(paths, n);
         return 1;
     }
+    for (int i = 1; i < n; ++i)
+    {
+        Image *img = load_image_as(paths[i], NULL, pixel_type);
+        ImageMetrics m;
+        if (!img || !image_compare(ref, img, &m, 1))
+        {
+            if (img)
+                printf("%s: %dx%dx%d does not match %s (%dx%dx%d)\n", paths[i], img->w, img->h, img->c, paths[0],
+                       ref->w, ref->h, ref->c);
+            else
+                printf("%s: cannot read\n", paths[i]);
+            free_image(img);
+            failed = 1;
+            continue;
+        }
+        if (json)
+        {
+            char psnr[32], ssim[32];
+            json_number(psnr, sizeof(psnr), "%.4f", m.psnr);
+            json_number(ssim, sizeof(ssim), "%.6f", m.ssim);
+            printf("{\"reference\": ");
+            json_string(paths[0]);
+            printf(", \"image\": ");
+            json_string(paths[i]);
+            printf(", \"width\": %d, \"height\": %d, \"channels\": %d, \"mse\": %.6f, \"psnr\": %s, "
+                   "\"max_diff\": %g, \"ssim\": %s}\n",
+                   img->w, img->h, img->c, m.mse, psnr, m.max_diff, ssim);
+        }
+        else
+            printf("%s vs %s: MSE %.4f, PSNR %.2f dB, max diff %g, SSIM %.4f\n", paths[i], paths[0], m.mse, m.psnr,
+                   m.max_diff, m.ssim);
+        free_image(img);
+    }
+    free_image(ref);
+    free_inputs(paths, n);
+    return failed;
+}
+
+#define POINT_OP_ARGS 4 // dip_tool point_op <path> <op>
+#define RESIZE_ARGS 8   // dip_tool resize <path> <in_w> <in_h> <out_w> <out_h> <method>
+
+static int run_command(int argc, char **argv)
+{
     if (strcmp(argv[1], "read_image") == 0)
     {
         cmd_read_image(argv[2]);
     }
     else if (strcmp(argv[1], "point_op") == 0)
     {
-        double g = (argc >= 5) ? atof(argv[4]) : 1.0;
-        cmd_point_op(argv[2], argv[3], g);
+        if (argc < POINT_OP_ARGS)
+        {
+            fprintf(stderr, "point_op args missing\n");
+            return 1;
+        }
+        // 最後的參數 planar：拆成通道平面再運算；tiled [<w>x<h>+<x>+<y>]：各 tile 平行運算，
+        // 可只算 ROI；gamma auto：依直方圖的平均亮度選 gamma；clahe 的預設截斷倍數為 2
+        Rect roi;
+        int has_roi = argc >= 6 && parse_rect(argv[argc - 1], &roi);
+        if (has_roi)
+            argc--;
+        const char *layout = "";
+        if (argc >= 5 && (strcmp(argv[argc - 1], "planar") == 0 || strcmp(argv[argc - 1], "tiled") == 0))
+            layout = argv[--argc];
+        if (has_roi && strcmp(layout, "tiled") != 0)
+        {
+            fprintf(stderr, "ROI needs the tiled layout\n");
+            skip_input(argv[2]);
+            return 1;
+        }
+        double g = (argc >= 5) ? (strcmp(argv[4], "auto") == 0 ? NAN : atof(argv[4]))
+                               : (strcmp(argv[3], "clahe") == 0 ? 2.0 : 1.0);
+        cmd_point_op(argv[2], argv[3], g, layout, has_roi ? &roi : NULL);
     }
     else if (strcmp(argv[1], "resize") == 0)
     {
-        if (argc < 8)
+        if (argc < RESIZE_ARGS)
         {
             fprintf(stderr, "resize args missing\n");
             return 1;
         }
+        // tiled 之後可接輸出座標的 ROI <w>x<h>+<x>+<y>
+        Rect roi;
+        const char *layout = argc >= 9 ? argv[8] : "";
+        if (argc >= 10 && (strcmp(layout, "tiled") != 0 || !parse_rect(argv[9], &roi)))
+        {
+            fprintf(stderr, "Bad ROI: %s (expected tiled <w>x<h>+<x>+<y>)\n", argv[9]);
+            skip_input(argv[2]);
+            return 1;
+        }
+        int iw = atoi(argv[3]), ih = atoi(argv[4]);
         int ow = atoi(argv[5]), oh = atoi(argv[6]);
-        cmd_resize(argv[2], ow, oh, argv[7]);
+        cmd_resize(argv[2], iw, ih, ow, oh, argv[7], layout, argc >= 10 ? &roi : NULL);
+    }
+    else if (strcmp(argv[1], "info") == 0)
+    {
+        return cmd_info(argc, argv);
+    }
+    else if (strcmp(argv[1], "stats") == 0)
+    {
+        return cmd_stats(argc, argv);
+    }
+    else if (strcmp(argv[1], "compare") == 0)
+    {
+        return cmd_compare(argc, argv);
+    }
+    else if (strcmp(argv[1], "pyramid") == 0)
+    {
+        int min_size = (argc >= 4) ? atoi(argv[3]) : 32;
+        int jobs = (argc >= 5) ? atoi(argv[4]) : 1;
+        cmd_pyramid(argv[2], min_size, jobs);
     }
     else
     {
@@ -207,3 +923,238 @@ int main(int argc, char **argv)
     }
     return 0;
 }
+
+#define BATCH_MAX_ARGS 16
+
+typedef struct
+{
+    char *line;
+    int argc;
+    char *argv[BATCH_MAX_ARGS];
+    double cost; // 由檔頭估計的像素數，用來排序
+} BatchJob;
+
+/** 只讀檔頭估計工作量：輸入像素數，resize 取輸入與輸出較大者 */
+static double batch_job_cost(const BatchJob *job)
+{
+    ImageInfo info;
+    if (!probe_image(job->argv[2], &info))
+        return 0.0;
+    double px = (double)info.w * info.h * info.c;
+    if (strcmp(job->argv[1], "resize") == 0 && job->argc >= 7)
+    {
+        double out = (double)atoi(job->argv[5]) * atoi(job->argv[6]) * info.c;
+        if (out > px)
+            px = out;
+    }
+    return px;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_job_cost(const void *a, const void *b)
+{
+    double ca = ((const BatchJob *)a)->cost, cb = ((const BatchJob *)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+/** 一定會解碼 argv[2] 的工作才預讀：沒有人取走的預讀會一直佔著預讀視窗。info 只讀檔頭，
+ *  參數不足或未知的子命令在讀檔前就結束；子命令內的檢查失敗時以 skip_input 釋放 */
+static int batch_reads_input(const BatchJob *job)
+{
+    const char *cmd = job->argv[1];
+    if (is_multi_input(job->argv[2]))
+        return 0;
+    if (strcmp(cmd, "point_op") == 0)
+        return job->argc >= POINT_OP_ARGS;
+    if (strcmp(cmd, "resize") == 0)
+        return job->argc >= RESIZE_ARGS;
+    return strcmp(cmd, "read_image") == 0 || strcmp(cmd, "stats") == 0 || strcmp(cmd, "compare") == 0 ||
+           strcmp(cmd, "pyramid") == 0;
+}
+
+static void batch_job_run(void *arg)
+{
+    BatchJob *job = (BatchJob *)arg;
+    run_command(job->argc, job->argv);
+}
+
+/** 每一行是一個子命令（與命令列相同的參數），整批丟進 work-stealing scheduler；
+ *  prefetch > 0 時輸入檔由 I/O 佇列預讀、輸出 PNG 非同步寫出，worker 只做運算 */
+static int cmd_batch(const char *list, Scheduler *sched, int prefetch)
+{
+    FILE *fp = fopen(list, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "Cannot read %s\n", list);
+        return 1;
+    }
+    int n = 0, cap = 64;
+    BatchJob *jobs = (BatchJob *)malloc(sizeof(BatchJob) * cap);
+    char buf[1024];
+    while (fgets(buf, sizeof(buf), fp))
+    {
+        char *hash = strchr(buf, '#');
+        if (hash)
+            *hash = '\0';
+        BatchJob job;
+        job.line = strdup(buf);
+        job.argc = 1;
+        job.argv[0] = "batch";
+        char *save = NULL;
+        for (char *tok = strtok_r(job.line, " \t\r\n", &save); tok && job.argc < BATCH_MAX_ARGS - 1;
+             tok = strtok_r(NULL, " \t\r\n", &save))
+            job.argv[job.argc++] = tok;
+        job.argv[job.argc] = NULL;
+        if (job.argc < 3 || strcmp(job.argv[1], "batch") == 0)
+        {
+            if (job.argc > 1)
+                fprintf(stderr, "skip batch line: %s\n", job.argv[1]);
+            free(job.line);
+            continue;
+        }
+        if (n == cap)
+        {
+            cap *= 2;
+            jobs = (BatchJob *)realloc(jobs, sizeof(BatchJob) * cap);
+        }
+        job.cost = batch_job_cost(&job);
+        jobs[n++] = job;
+    }
+    fclose(fp);
+
+    // 由小到大送出：worker 從自己 deque 底端（最後放入）取，因此各 worker 先做最大的工作
+    qsort(jobs, n, sizeof(BatchJob), cmp_job_cost);
+    SchedStats st;
+    if (prefetch < 0)
+    {
+        sched_stats(sched, &st);
+        prefetch = 2 * st.workers;
+    }
+    IoQueue *io = NULL;
+    if (prefetch > 0)
+    {
+        // 預讀順序與預期的執行順序相同（大的先做）；目錄與 glob 由 pipeline 自己讀
+        io = io_create(IO_AUTO, prefetch);
+        for (int i = n - 1; i >= 0; --i)
+            if (batch_reads_input(&jobs[i]))
+                io_prefetch(io, jobs[i].argv[2]);
+        io_set_default(io);
+    }
+    double t0 = now_s();
+    for (int i = 0; i < n; ++i)
+        sched_submit(sched, batch_job_run, &jobs[i]);
+    sched_wait(sched);
+    if (io)
+        io_flush(io);
+    double wall = now_s() - t0;
+
+    sched_stats(sched, &st);
+    printf("batch: %d jobs, workers=%d tasks=%ld steals=%ld queue_depth=%d max_queue_depth=%d, %.3f s\n",
+           n, st.workers, st.tasks, st.steals, st.queue_depth, st.max_queue_depth, wall);
+    if (io)
+    {
+        IoStats is;
+        io_stats(io, &is);
+        double busy = wall * st.workers;
+        printf("io: %s, %ld reads (%ld prefetched ready, %ld unclaimed), %ld writes, %ld failed, %.1f MB; "
+               "I/O wait %.3f s = %.1f%% of worker time\n",
+               is.backend, is.reads, is.prefetch_ready, is.unclaimed, is.writes, is.failed,
+               (is.bytes_read + is.bytes_written) / 1048576.0, is.wait_s,
+               busy > 0 ? 100.0 * is.wait_s / busy : 0.0);
+        io_set_default(NULL);
+        io_destroy(io);
+    }
+    pool_print_stats(image_pool());
+    for (int i = 0; i < n; ++i)
+        free(jobs[i].line);
+    free(jobs);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    // 全域選項必須放在子命令之前：--out <dir> 改變輸出根目錄（預設 out/），
+    // --raw <spec> 指定 RAW 檔的預設尺寸（否則讀 sidecar 或由檔案大小推測），
+    // --depth 8|16|f32 指定讀檔後的像素型別（16/f32 時結果寫成 16-bit PNG），
+    // --cache <dir> 啟用結果快取，--cache-size <MB> 為快取目錄的大小上限（預設 256）
+    const char *cache_dir = NULL;
+    double cache_mb = 256;
+    while (argc >= 3 &&
+           (strcmp(argv[1], "--out") == 0 || strcmp(argv[1], "--raw") == 0 || strcmp(argv[1], "--depth") == 0 ||
+            strcmp(argv[1], "--cache") == 0 || strcmp(argv[1], "--cache-size") == 0))
+    {
+        if (strcmp(argv[1], "--out") == 0)
+        {
+            set_out_root(argv[2]);
+        }
+        else if (strcmp(argv[1], "--cache") == 0)
+        {
+            cache_dir = argv[2];
+        }
+        else if (strcmp(argv[1], "--cache-size") == 0)
+        {
+            cache_mb = atof(argv[2]);
+        }
+        else if (strcmp(argv[1], "--depth") == 0)
+        {
+            if (!pixel_type_from_name(argv[2], &pixel_type))
+            {
+                fprintf(stderr, "Bad --depth: %s (expected 8|16|f32)\n", argv[2]);
+                return 1;
+            }
+        }
+        else
+        {
+            RawFormat fmt;
+            if (!parse_raw_spec(argv[2], &fmt))
+            {
+                fprintf(stderr, "Bad --raw spec: %s (expected <w>x<h>[x<c>][@<bits>][be])\n", argv[2]);
+                return 1;
+            }
+            set_raw_default(&fmt);
+            raw_spec = argv[2];
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc < 3)
+    {
+        fprintf(stderr,
+                "Usage: (any command may be preceded by --out <dir>, default out/, --raw <w>x<h>[x<c>][@<bits>][be], --depth 8|16|f32,\n"
+                "        --cache <dir> and --cache-size <MB>, default 256)\n"
+                "  %s read_raw <path.raw>\n"
+                "  %s read_jpg <path.jpg>\n"
+                "  %s point_op <path.(jpg/png)|dir|glob> <log|gamma|negative|equalize|stretch|clahe> [gamma|auto|clip%%|clip limit] [planar|tiled [<w>x<h>+<x>+<y>]]\n"
+                "  %s resize <path.(raw/jpg/png)|dir|glob> <in_w> <in_h> <out_w> <out_h> <nearest|bilinear|area|bicubic|lanczos3|mitchell> [planar|tiled [<w>x<h>+<x>+<y>]]\n"
+                "  %s pyramid <path.(raw/jpg/png)> [min_size=32] [jobs=1]\n"
+                "  %s batch <jobs.txt> [workers] [prefetch=2*workers, 0 = blocking I/O]\n"
+                "  %s info <path|dir|glob>...\n"
+                "  %s stats <path|dir|glob>...\n"
+                "  %s compare <reference> <path|dir|glob>... [json]\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    if (cache_dir && !cache_open(cache_dir, (size_t)(cache_mb * 1048576.0)))
+        fprintf(stderr, "warning: cannot use cache directory %s\n", cache_dir);
+    // 單張影像的運算也透過同一個 scheduler 切成 row band 平行執行
+    int workers = (strcmp(argv[1], "batch") == 0 && argc >= 4) ? atoi(argv[3]) : 0;
+    Scheduler *sched = sched_create(workers);
+    sched_set_default(sched);
+    int rc;
+    if (strcmp(argv[1], "batch") == 0)
+    {
+        rc = cmd_batch(argv[2], sched, argc >= 5 ? atoi(argv[4]) : -1);
+    }
+    else
+        rc = run_command(argc, argv);
+    sched_destroy(sched);
+    cache_close();
+    return rc;
+}
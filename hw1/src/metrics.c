@@ -0,0 +1,258 @@
+// Image quality metrics.
+// MSE / max-diff 以 row band 平行、一次掃過兩張影像（8-bit 用 SSE2）；SSIM 的視窗和
+// 拆成水平與垂直兩次滑動和，每個輸出樣本的成本與視窗大小無關。
+
+#include "metrics.h"
+#include "sched.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SSIM_SUMS 5 // a, b, a*a, b*b, a*b
+
+typedef struct
+{
+    double sse, max;
+} ErrBand;
+
+typedef struct
+{
+    const Image *a, *b;
+    int rows;
+    ErrBand *err;
+    double *ssim;     // 每個 band 的 SSIM 總和
+    double c1, c2;
+} MetricJob;
+
+static double peak_of(PixelType type)
+{
+    return type == PIXEL_U16 ? 65535.0 : (type == PIXEL_F32 ? 1.0 : 255.0);
+}
+
+// ---------------- MSE / max-diff ----------------
+/** |a-b| 由兩個飽和減法 OR 起來，平方和用 madd 累加到 32-bit，每 8192 次倒進 64-bit 以免溢位 */
+static void err_u8(const unsigned char *a, const unsigned char *b, size_t n, ErrBand *e)
+{
+    size_t i = 0;
+    unsigned long long sse = 0;
+    int max = 0;
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128(), vmax = zero;
+    while (i + 16 <= n)
+    {
+        size_t end = n - i > (size_t)16 * 8192 ? i + (size_t)16 * 8192 : n;
+        __m128i acc = zero;
+        for (; i + 16 <= end; i += 16)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+            __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            vmax = _mm_max_epu8(vmax, d);
+            __m128i lo = _mm_unpacklo_epi8(d, zero), hi = _mm_unpackhi_epi8(d, zero);
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+        }
+        unsigned int lane[4];
+        _mm_storeu_si128((__m128i *)lane, acc);
+        sse += (unsigned long long)lane[0] + lane[1] + lane[2] + lane[3];
+    }
+    unsigned char m[16];
+    _mm_storeu_si128((__m128i *)m, vmax);
+    for (int k = 0; k < 16; ++k)
+        if (m[k] > max)
+            max = m[k];
+#endif
+    for (; i < n; ++i)
+    {
+        int d = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        sse += (unsigned long long)(d * d);
+        if (d > max)
+            max = d;
+    }
+    e->sse = (double)sse;
+    e->max = max;
+}
+
+#define DEFINE_ERR_WIDE(SUFFIX, T)                                      \
+    static void err_##SUFFIX(const T *a, const T *b, size_t n, ErrBand *e) \
+    {                                                                   \
+        double sse = 0, max = 0;                                        \
+        for (size_t i = 0; i < n; ++i)                                  \
+        {                                                               \
+            double d = (double)a[i] - (double)b[i];                     \
+            sse += d * d;                                               \
+            max = fmax(max, fabs(d));                                   \
+        }                                                               \
+        e->sse = sse;                                                   \
+        e->max = max;                                                   \
+    }
+
+DEFINE_ERR_WIDE(u16, unsigned short)
+DEFINE_ERR_WIDE(f32, float)
+
+static void err_band(void *arg, int y0, int y1)
+{
+    MetricJob *job = (MetricJob *)arg;
+    const Image *a = job->a;
+    ErrBand *e = &job->err[y0 / job->rows];
+    size_t row = (size_t)a->w * a->c;
+    size_t off = y0 * row, n = (y1 - y0) * row;
+    if (a->type == PIXEL_U16)
+        err_u16((const unsigned short *)a->data + off, (const unsigned short *)job->b->data + off, n, e);
+    else if (a->type == PIXEL_F32)
+        err_f32((const float *)a->data + off, (const float *)job->b->data + off, n, e);
+    else
+        err_u8(a->data + off, job->b->data + off, n, e);
+}
+
+// ---------------- SSIM ----------------
+/** 取出第 y 列的通道 k（樣本單位，不正規化：整數影像的視窗和在 double 中是精確的） */
+static void load_channel(const Image *img, int y, int k, double *dst)
+{
+    size_t p = (size_t)y * img->w * img->c + k;
+    if (img->type == PIXEL_U16)
+    {
+        const unsigned short *s = (const unsigned short *)img->data + p;
+        for (int x = 0; x < img->w; ++x)
+            dst[x] = s[(size_t)x * img->c];
+    }
+    else if (img->type == PIXEL_F32)
+    {
+        const float *s = (const float *)img->data + p;
+        for (int x = 0; x < img->w; ++x)
+            dst[x] = s[(size_t)x * img->c];
+    }
+    else
+    {
+        const unsigned char *s = img->data + p;
+        for (int x = 0; x < img->w; ++x)
+            dst[x] = s[(size_t)x * img->c];
+    }
+}
+
+/** 一列的水平滑動和：h[j][x] = 第 j 個量在 [x, x + SSIM_WIN) 的和 */
+static void row_sums(const double *pa, const double *pb, int w, double *h, int ow)
+{
+    double s[SSIM_SUMS] = {0};
+    for (int x = 0; x < SSIM_WIN; ++x)
+    {
+        s[0] += pa[x];
+        s[1] += pb[x];
+        s[2] += pa[x] * pa[x];
+        s[3] += pb[x] * pb[x];
+        s[4] += pa[x] * pb[x];
+    }
+    for (int x = 0; x < ow; ++x)
+    {
+        for (int j = 0; j < SSIM_SUMS; ++j)
+            h[j * ow + x] = s[j];
+        if (x + SSIM_WIN >= w)
+            break;
+        double ia = pa[x + SSIM_WIN], ib = pb[x + SSIM_WIN], oa = pa[x], ob = pb[x];
+        s[0] += ia - oa;
+        s[1] += ib - ob;
+        s[2] += ia * ia - oa * oa;
+        s[3] += ib * ib - ob * ob;
+        s[4] += ia * ib - oa * ob;
+    }
+}
+
+/** 輸出列 [y0, y1) 的 SSIM 總和：最近 SSIM_WIN 列的水平和放在環狀緩衝區，
+ *  垂直和每往下一列只加上新的一列、減去離開視窗的一列 */
+static void ssim_band(void *arg, int y0, int y1)
+{
+    MetricJob *job = (MetricJob *)arg;
+    const Image *a = job->a, *b = job->b;
+    int w = a->w, ow = w - SSIM_WIN + 1;
+    double *pa = (double *)malloc(sizeof(double) * w * 2), *pb = pa + w;
+    double *ring = (double *)malloc(sizeof(double) * SSIM_WIN * SSIM_SUMS * ow);
+    double *col = (double *)malloc(sizeof(double) * SSIM_SUMS * ow);
+    const double n = SSIM_WIN * SSIM_WIN, inv_n = 1.0 / n, cov_norm = n / (n - 1);
+    double total = 0;
+    for (int k = 0; k < a->c; ++k)
+    {
+        memset(col, 0, sizeof(double) * SSIM_SUMS * ow);
+        for (int r = 0; r < SSIM_WIN; ++r)
+        {
+            double *h = &ring[(size_t)r * SSIM_SUMS * ow];
+            load_channel(a, y0 + r, k, pa);
+            load_channel(b, y0 + r, k, pb);
+            row_sums(pa, pb, w, h, ow);
+            for (int i = 0; i < SSIM_SUMS * ow; ++i)
+                col[i] += h[i];
+        }
+        for (int y = y0; y < y1; ++y)
+        {
+            const double *sa = col, *sb = col + ow, *saa = col + 2 * ow, *sbb = col + 3 * ow, *sab = col + 4 * ow;
+            for (int x = 0; x < ow; ++x)
+            {
+                double ma = sa[x] * inv_n, mb = sb[x] * inv_n;
+                double va = cov_norm * (saa[x] * inv_n - ma * ma);
+                double vb = cov_norm * (sbb[x] * inv_n - mb * mb);
+                double vab = cov_norm * (sab[x] * inv_n - ma * mb);
+                total += ((2 * ma * mb + job->c1) * (2 * vab + job->c2)) /
+                         ((ma * ma + mb * mb + job->c1) * (va + vb + job->c2));
+            }
+            if (y + 1 == y1)
+                break;
+            double *h = &ring[(size_t)((y - y0) % SSIM_WIN) * SSIM_SUMS * ow];
+            for (int i = 0; i < SSIM_SUMS * ow; ++i)
+                col[i] -= h[i];
+            load_channel(a, y + SSIM_WIN, k, pa);
+            load_channel(b, y + SSIM_WIN, k, pb);
+            row_sums(pa, pb, w, h, ow);
+            for (int i = 0; i < SSIM_SUMS * ow; ++i)
+                col[i] += h[i];
+        }
+    }
+    job->ssim[y0 / job->rows] = total;
+    free(pa);
+    free(ring);
+    free(col);
+}
+
+int image_compare(const Image *a, const Image *b, ImageMetrics *m, int want_ssim)
+{
+    if (a->w != b->w || a->h != b->h || a->c != b->c || a->type != b->type)
+        return 0;
+    m->mse = m->max_diff = 0;
+    m->psnr = INFINITY;
+    m->ssim = NAN;
+    if ((size_t)a->w * a->h * a->c == 0)
+        return 1;
+
+    Scheduler *s = sched_default();
+    double peak = peak_of(a->type);
+    MetricJob job = {a, b, sched_band_rows(a->h), NULL, NULL, 0.01 * peak * 0.01 * peak,
+                     0.03 * peak * 0.03 * peak};
+    int nb = (a->h + job.rows - 1) / job.rows;
+    job.err = (ErrBand *)malloc(sizeof(ErrBand) * nb);
+    sched_parallel_for(s, 0, a->h, job.rows, err_band, &job);
+    double sse = 0;
+    for (int i = 0; i < nb; ++i)
+    {
+        sse += job.err[i].sse;
+        m->max_diff = fmax(m->max_diff, job.err[i].max);
+    }
+    free(job.err);
+    m->mse = sse / ((double)a->w * a->h * a->c);
+    if (m->mse > 0)
+        m->psnr = 10.0 * log10(peak * peak / m->mse);
+
+    if (want_ssim && a->w >= SSIM_WIN && a->h >= SSIM_WIN)
+    {
+        int oh = a->h - SSIM_WIN + 1;
+        job.rows = sched_band_rows(oh);
+        nb = (oh + job.rows - 1) / job.rows;
+        job.ssim = (double *)malloc(sizeof(double) * nb);
+        sched_parallel_for(s, 0, oh, job.rows, ssim_band, &job);
+        double total = 0;
+        for (int i = 0; i < nb; ++i)
+            total += job.ssim[i];
+        free(job.ssim);
+        m->ssim = total / ((double)(a->w - SSIM_WIN + 1) * oh * a->c);
+    }
+    return 1;
+}
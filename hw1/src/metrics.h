@@ -0,0 +1,25 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "image.h"
+
+// Full-reference image quality metrics (metrics.c).
+// Errors are in sample units of the common pixel type and PSNR uses that
+// type's peak (255, 65535 or 1.0). SSIM uses a 7x7 uniform window with
+// sample covariance and K1 = 0.01, K2 = 0.03 (the scikit-image defaults),
+// averaged over all fully covered windows and channels.
+
+#define SSIM_WIN 7
+
+typedef struct
+{
+    double mse;
+    double psnr;     // dB; INFINITY when the images are identical
+    double max_diff;
+    double ssim;     // NAN when not requested or the image is smaller than the window
+} ImageMetrics;
+
+// 0 if the images differ in width, height, channels or pixel type
+int image_compare(const Image *a, const Image *b, ImageMetrics *m, int want_ssim);
+
+#endif
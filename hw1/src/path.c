@@ -0,0 +1,144 @@
+// Output path helpers.
+// 取代原本回傳 static 緩衝區的 file_stem：結果一律寫進呼叫端的 buffer，
+// 並回傳需要的長度，讓呼叫端能偵測路徑過長被截斷的情況。
+
+#define _POSIX_C_SOURCE 200809L
+#include "path.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(p) _mkdir(p)
+#else
+#define make_dir(p) mkdir(p, 0755)
+#endif
+
+static const char *root_dir = "out";
+
+void set_out_root(const char *root)
+{
+    root_dir = (root && *root) ? root : "out";
+}
+
+const char *out_root(void)
+{
+    return root_dir;
+}
+
+size_t path_stem(const char *path, char *buf, size_t n)
+{
+    const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+    const char *bslash = strrchr(path, '\\');
+    if (!slash || (bslash && bslash > slash))
+        slash = bslash;
+#endif
+    const char *name = slash ? slash + 1 : path;
+    const char *dot = strrchr(name, '.');
+    size_t len = dot ? (size_t)(dot - name) : strlen(name);
+    if (n > 0)
+    {
+        size_t k = len < n - 1 ? len : n - 1;
+        memcpy(buf, name, k);
+        buf[k] = '\0';
+    }
+    return len;
+}
+
+size_t out_path(char *buf, size_t n, const char *subdir, const char *src_path, const char *suffix_fmt, ...)
+{
+    size_t used = 0;
+    int k = snprintf(buf, n, "%s/%s/", root_dir, subdir);
+    if (k < 0)
+        return (size_t)-1;
+    used = (size_t)k;
+
+    used += path_stem(src_path, used < n ? buf + used : NULL, used < n ? n - used : 0);
+
+    va_list ap;
+    va_start(ap, suffix_fmt);
+    k = vsnprintf(used < n ? buf + used : NULL, used < n ? n - used : 0, suffix_fmt, ap);
+    va_end(ap);
+    if (k < 0)
+        return (size_t)-1;
+    used += (size_t)k;
+
+    k = snprintf(used < n ? buf + used : NULL, used < n ? n - used : 0, ".png");
+    used += (size_t)k;
+    return used;
+}
+
+// ---------------- Directory creation ----------------
+typedef struct DirEntry
+{
+    struct DirEntry *next;
+    char path[];
+} DirEntry;
+
+static DirEntry *known_dirs;
+static pthread_mutex_t dirs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int dir_known(const char *path)
+{
+    for (DirEntry *e = known_dirs; e; e = e->next)
+        if (strcmp(e->path, path) == 0)
+            return 1;
+    return 0;
+}
+
+/** 逐層建立目錄（取代 system("mkdir -p")），已建立過的路徑直接略過 */
+int ensure_dir(const char *path)
+{
+    size_t len = strlen(path);
+    if (len == 0 || len >= OUT_PATH_MAX)
+        return -1;
+
+    pthread_mutex_lock(&dirs_lock);
+    if (dir_known(path))
+    {
+        pthread_mutex_unlock(&dirs_lock);
+        return 0;
+    }
+
+    char buf[OUT_PATH_MAX];
+    memcpy(buf, path, len + 1);
+    int rc = 0;
+    for (char *p = buf + 1; rc == 0; ++p)
+    {
+        if (*p != '/' && *p != '\0')
+            continue;
+        char saved = *p;
+        *p = '\0';
+        if (make_dir(buf) != 0 && errno != EEXIST)
+            rc = -1;
+        *p = saved;
+        if (saved == '\0')
+            break;
+    }
+    struct stat sb;
+    if (rc == 0 && (stat(path, &sb) != 0 || !S_ISDIR(sb.st_mode)))
+        rc = -1;
+    if (rc == 0)
+    {
+        DirEntry *e = (DirEntry *)malloc(sizeof(DirEntry) + len + 1);
+        memcpy(e->path, path, len + 1);
+        e->next = known_dirs;
+        known_dirs = e;
+    }
+    pthread_mutex_unlock(&dirs_lock);
+    return rc;
+}
+
+int ensure_out_dir(const char *subdir)
+{
+    char buf[OUT_PATH_MAX];
+    int k = snprintf(buf, sizeof(buf), "%s/%s", root_dir, subdir);
+    if (k < 0 || (size_t)k >= sizeof(buf))
+        return -1;
+    return ensure_dir(buf);
+}
@@ -0,0 +1,29 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include <stddef.h>
+
+// Reentrant output-path construction (path.c). Nothing here uses static
+// storage or allocates, so it is safe to call from any number of threads.
+// Functions return the full length they needed (like snprintf); a result
+// >= n means the buffer was too small and the output is truncated.
+
+#define OUT_PATH_MAX 4096
+
+// file name without directory and last extension: "data/lena.raw" -> "lena"
+size_t path_stem(const char *path, char *buf, size_t n);
+
+// output root directory (default "out"); set once at startup, before threads
+void set_out_root(const char *root);
+const char *out_root(void);
+
+// "<root>/<subdir>/<stem><suffix>.png", suffix is a printf format
+size_t out_path(char *buf, size_t n, const char *subdir, const char *src_path, const char *suffix_fmt, ...)
+    __attribute__((format(printf, 5, 6)));
+
+// mkdir -p with native syscalls; directories already created by this process
+// are remembered and skipped. 0 on success.
+int ensure_dir(const char *path);
+int ensure_out_dir(const char *subdir); // <root>/<subdir>
+
+#endif
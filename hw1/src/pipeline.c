@@ -0,0 +1,353 @@
+// Decode / compute / encode pipeline.
+// 三個階段各有自己的執行緒，中間以有界佇列相接；佇列滿時上游會被擋住（backpressure），
+// 因此同時在記憶體中的影像數量有上限。
+
+#define _POSIX_C_SOURCE 200809L
+#include "pipeline.h"
+#include "sched.h"
+#include "path.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <glob.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+typedef struct
+{
+    int index;
+    int in_w, in_h;
+    Image *img;
+} Item;
+
+typedef struct
+{
+    Item *buf;
+    int cap, head, count;
+    int producers; // 尚未結束的上游執行緒數，歸零時佇列視為關閉
+    pthread_mutex_t lock;
+    pthread_cond_t not_full, not_empty;
+} BoundedQueue;
+
+static void queue_init(BoundedQueue *q, int cap, int producers)
+{
+    q->buf = (Item *)malloc(sizeof(Item) * cap);
+    q->cap = cap;
+    q->head = 0;
+    q->count = 0;
+    q->producers = producers;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+}
+
+static void queue_destroy(BoundedQueue *q)
+{
+    free(q->buf);
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+}
+
+/** 放入一個項目；佇列滿時等待，回傳是否曾被擋住 */
+static int queue_push(BoundedQueue *q, Item it)
+{
+    int stalled = 0;
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->cap)
+    {
+        stalled = 1;
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    q->buf[(q->head + q->count) % q->cap] = it;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return stalled;
+}
+
+/** 取出一個項目；佇列已空且上游都結束時回傳 0 */
+static int queue_pop(BoundedQueue *q, Item *it)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && q->producers > 0)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    int ok = q->count > 0;
+    if (ok)
+    {
+        *it = q->buf[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static void queue_producer_done(BoundedQueue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->producers--;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+typedef struct
+{
+    const char *const *paths;
+    int n;
+    const PipelineConfig *cfg;
+    BoundedQueue decoded, computed;
+    int next;
+    pthread_mutex_t lock; // 保護 next 與統計
+    PipelineStats st;
+} Pipeline;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *decode_stage(void *arg)
+{
+    Pipeline *p = (Pipeline *)arg;
+    double busy = 0.0;
+    long stalls = 0;
+    int failed = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&p->lock);
+        int i = p->next++;
+        pthread_mutex_unlock(&p->lock);
+        if (i >= p->n)
+            break;
+        double t0 = now_s();
+        Item it = {i, 0, 0, load_image_as(p->paths[i], NULL, p->cfg->type)};
+        busy += now_s() - t0;
+        if (!it.img)
+        {
+            fprintf(stderr, "Cannot read %s\n", p->paths[i]);
+            failed++;
+            continue;
+        }
+        it.in_w = it.img->w;
+        it.in_h = it.img->h;
+        stalls += queue_push(&p->decoded, it);
+    }
+    queue_producer_done(&p->decoded);
+    pthread_mutex_lock(&p->lock);
+    p->st.decode_s += busy;
+    p->st.decode_stalls += stalls;
+    p->st.failed += failed;
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void *compute_stage(void *arg)
+{
+    Pipeline *p = (Pipeline *)arg;
+    double busy = 0.0;
+    long stalls = 0;
+    int failed = 0;
+    Item it;
+    while (queue_pop(&p->decoded, &it))
+    {
+        double t0 = now_s();
+        Image *res = p->cfg->op ? p->cfg->op(it.img, p->cfg->op_arg) : it.img;
+        if (res != it.img)
+            free_image(it.img);
+        busy += now_s() - t0;
+        if (!res)
+        {
+            failed++;
+            continue;
+        }
+        it.img = res;
+        stalls += queue_push(&p->computed, it);
+    }
+    queue_producer_done(&p->computed);
+    pthread_mutex_lock(&p->lock);
+    p->st.compute_s += busy;
+    p->st.compute_stalls += stalls;
+    p->st.failed += failed;
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void *encode_stage(void *arg)
+{
+    Pipeline *p = (Pipeline *)arg;
+    double busy = 0.0;
+    int done = 0;
+    Item it;
+    char outp[OUT_PATH_MAX];
+    while (queue_pop(&p->computed, &it))
+    {
+        double t0 = now_s();
+        if (p->cfg->name(p->paths[it.index], it.in_w, it.in_h, it.img, outp, sizeof(outp), p->cfg->name_arg))
+        {
+            save_png(outp, it.img);
+            done++;
+        }
+        free_image(it.img);
+        busy += now_s() - t0;
+    }
+    pthread_mutex_lock(&p->lock);
+    p->st.encode_s += busy;
+    p->st.images += done;
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+void pipeline_default_config(PipelineConfig *cfg)
+{
+    int cpus = sched_cpu_count();
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->decoders = cpus > 4 ? 2 : 1;
+    cfg->encoders = cpus > 4 ? cpus / 4 : 1;
+    cfg->workers = cpus - cfg->decoders - cfg->encoders > 0 ? cpus - cfg->decoders - cfg->encoders : 1;
+    cfg->queue_cap = 2 * cpus;
+}
+
+int pipeline_run(const char *const *paths, int n, const PipelineConfig *cfg, PipelineStats *st)
+{
+    Pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.paths = paths;
+    p.n = n;
+    p.cfg = cfg;
+    int nd = cfg->decoders > 0 ? cfg->decoders : 1;
+    int nw = cfg->workers > 0 ? cfg->workers : 1;
+    int ne = cfg->encoders > 0 ? cfg->encoders : 1;
+    int cap = cfg->queue_cap > 0 ? cfg->queue_cap : 4;
+    queue_init(&p.decoded, cap, nd);
+    queue_init(&p.computed, cap, nw);
+    pthread_mutex_init(&p.lock, NULL);
+
+    double t0 = now_s();
+    int total = nd + nw + ne;
+    pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) * total);
+    for (int i = 0; i < total; ++i)
+    {
+        void *(*fn)(void *) = i < nd ? decode_stage : (i < nd + nw ? compute_stage : encode_stage);
+        pthread_create(&tids[i], NULL, fn, &p);
+    }
+    for (int i = 0; i < total; ++i)
+        pthread_join(tids[i], NULL);
+    p.st.wall_s = now_s() - t0;
+    free(tids);
+
+    queue_destroy(&p.decoded);
+    queue_destroy(&p.computed);
+    pthread_mutex_destroy(&p.lock);
+    if (st)
+        *st = p.st;
+    return p.st.failed == 0;
+}
+
+void pipeline_print_stats(const PipelineStats *st)
+{
+    printf("pipeline: %d images (%d failed) in %.3f s, %.1f images/s\n",
+           st->images, st->failed, st->wall_s, st->wall_s > 0 ? st->images / st->wall_s : 0.0);
+    printf("  busy: decode %.3f s, compute %.3f s, encode %.3f s; stalls: decode %ld, compute %ld\n",
+           st->decode_s, st->compute_s, st->encode_s, st->decode_stalls, st->compute_stalls);
+}
+
+// ---------------- Input enumeration ----------------
+int is_multi_input(const char *arg)
+{
+    struct stat sb;
+    if (strpbrk(arg, "*?["))
+        return 1;
+    return stat(arg, &sb) == 0 && S_ISDIR(sb.st_mode);
+}
+
+static int cmp_path(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/** 目錄中要列出的檔案：probe_image 認得的影像，但不含 RAW 的 sidecar（<檔名>.hdr）；
+ *  沒有檔頭的檔案只在副檔名為 .raw 時列出，否則任何大小剛好的檔案都會被當成影像 */
+static int is_dir_image(const char *name, const char *full)
+{
+    size_t n = strlen(name);
+    ImageInfo info;
+    if (n >= 4 && strcmp(name + n - 4, ".hdr") == 0)
+        return 0;
+    if (!probe_image(full, &info))
+        return 0;
+    return !info.raw || (n >= 4 && strcmp(name + n - 4, ".raw") == 0);
+}
+
+/** 目錄：列出其中的影像檔（略過隱藏檔）；否則當成 glob pattern 展開 */
+int collect_inputs(const char *arg, char ***paths)
+{
+    struct stat sb;
+    int n = 0;
+    char **out = NULL;
+    if (stat(arg, &sb) == 0 && S_ISDIR(sb.st_mode))
+    {
+        DIR *dir = opendir(arg);
+        if (!dir)
+            return -1;
+        int cap = 16;
+        size_t len = strlen(arg);
+        int slash = len > 0 && arg[len - 1] == '/';
+        out = (char **)malloc(sizeof(char *) * cap);
+        struct dirent *de;
+        while ((de = readdir(dir)))
+        {
+            if (de->d_name[0] == '.')
+                continue;
+            size_t need = len + strlen(de->d_name) + 2;
+            char *full = (char *)malloc(need);
+            snprintf(full, need, "%s%s%s", arg, slash ? "" : "/", de->d_name);
+            if (stat(full, &sb) != 0 || !S_ISREG(sb.st_mode) || !is_dir_image(de->d_name, full))
+            {
+                free(full);
+                continue;
+            }
+            if (n == cap)
+            {
+                cap *= 2;
+                out = (char **)realloc(out, sizeof(char *) * cap);
+            }
+            out[n++] = full;
+        }
+        closedir(dir);
+    }
+    else
+    {
+        glob_t g;
+        int rc = glob(arg, 0, NULL, &g);
+        if (rc == GLOB_NOMATCH)
+        {
+            *paths = NULL;
+            return 0;
+        }
+        if (rc != 0)
+            return -1;
+        out = (char **)malloc(sizeof(char *) * (g.gl_pathc > 0 ? g.gl_pathc : 1));
+        for (size_t i = 0; i < g.gl_pathc; ++i)
+            if (stat(g.gl_pathv[i], &sb) == 0 && S_ISREG(sb.st_mode))
+                out[n++] = strdup(g.gl_pathv[i]);
+        globfree(&g);
+    }
+    qsort(out, n, sizeof(char *), cmp_path);
+    *paths = out;
+    return n;
+}
+
+void free_inputs(char **paths, int n)
+{
+    if (!paths)
+        return;
+    for (int i = 0; i < n; ++i)
+        free(paths[i]);
+    free(paths);
+}
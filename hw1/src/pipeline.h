@@ -0,0 +1,48 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include "image.h"
+
+// Three-stage decode -> compute -> encode pipeline (pipeline.c).
+// Stages are connected by bounded queues, so decoding image N+1 overlaps with
+// computing N and encoding N-1, and a slow stage blocks the one before it.
+
+// the op owns img: it may work in place and return img itself, or return a new
+// image (img is then freed by the pipeline); NULL counts as a failure
+typedef Image *(*PipelineOp)(Image *img, const void *arg);
+// write the output path for `in_path` (decoded as in_w x in_h) into buf; return 0 to skip saving
+typedef int (*PipelineNameFn)(const char *in_path, int in_w, int in_h, const Image *res,
+                              char *buf, size_t n, const void *arg);
+
+typedef struct
+{
+    int decoders, workers, encoders; // thread count per stage (>= 1)
+    int queue_cap;                   // capacity of each inter-stage queue
+    PixelType type;                  // decoded pixel type (default PIXEL_U8)
+    PipelineOp op;
+    const void *op_arg;
+    PipelineNameFn name;
+    const void *name_arg;
+} PipelineConfig;
+
+typedef struct
+{
+    int images;    // successfully encoded
+    int failed;    // decode or compute failures
+    double wall_s;
+    double decode_s, compute_s, encode_s; // busy time summed over each stage's threads
+    long decode_stalls, compute_stalls;   // pushes that blocked on a full queue
+} PipelineStats;
+
+void pipeline_default_config(PipelineConfig *cfg);
+int pipeline_run(const char *const *paths, int n, const PipelineConfig *cfg, PipelineStats *st);
+void pipeline_print_stats(const PipelineStats *st);
+
+// expand a directory (its image files, without RAW .hdr sidecars) or a glob
+// pattern into a sorted path list
+int is_multi_input(const char *arg);
+int collect_inputs(const char *arg, char ***paths); // returns count, -1 on error
+void free_inputs(char **paths, int n);
+
+#endif
@@ -0,0 +1,235 @@
+// Planar (SoA) layout: 每個通道一個連續平面，方便以整個向量寬度處理單一通道，
+// 也能讓各通道平行運算。平面都指向同一塊記憶體。
+
+#include "image.h"
+#include "sched.h"
+#include <stdlib.h>
+#include <string.h>
+// SSSE3 版本以 target attribute 編譯、執行時偵測 CPU：預設的 -O2（x86-64 baseline）也用得到
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PLANAR_SSSE3 1
+#include <tmmintrin.h>
+#define SSSE3_FN __attribute__((target("ssse3")))
+#else
+#define PLANAR_SSSE3 0
+#endif
+
+PlanarImage *create_planar(int w, int h, int c)
+{
+    if (c < 1 || c > PLANAR_MAX_CHANNELS)
+        return NULL;
+    PlanarImage *p = (PlanarImage *)malloc(sizeof(PlanarImage));
+    size_t n = (size_t)w * h;
+    p->w = w;
+    p->h = h;
+    p->c = c;
+    p->data = (unsigned char *)malloc(n * c);
+    for (int i = 0; i < c; ++i)
+        p->plane[i] = p->data + n * i;
+    return p;
+}
+
+void free_planar(PlanarImage *p)
+{
+    if (!p)
+        return;
+    free(p->data);
+    free(p);
+}
+
+/** 平面視為單通道 Image（不複製） */
+Image planar_view(const PlanarImage *p, int ch)
+{
+    Image v;
+    v.w = p->w;
+    v.h = p->h;
+    v.c = 1;
+    v.data = p->plane[ch];
+    v.type = PIXEL_U8;
+    return v;
+}
+
+#if PLANAR_SSSE3
+static int has_ssse3(void)
+{
+    return __builtin_cpu_supports("ssse3"); // libgcc 啟動時已偵測好，只讀一個全域變數
+}
+
+/** RGB 交錯 → 三個平面，每次以 pshufb 拆 16 個像素；回傳處理到的像素數 */
+SSSE3_FN static size_t deinterleave3_ssse3(const unsigned char *src, unsigned char *r, unsigned char *g,
+                                           unsigned char *b, size_t n)
+{
+    size_t i = 0;
+    // 三個 16-byte 區塊中各通道的位置，-1 代表填 0
+    const __m128i m0r = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i m1r = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+    const __m128i m2r = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+    const __m128i m0g = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i m1g = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+    const __m128i m2g = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+    const __m128i m0b = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i m1b = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i m2b = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 3));
+        __m128i bb = _mm_loadu_si128((const __m128i *)(src + i * 3 + 16));
+        __m128i cc = _mm_loadu_si128((const __m128i *)(src + i * 3 + 32));
+        __m128i vr = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m0r), _mm_shuffle_epi8(bb, m1r)), _mm_shuffle_epi8(cc, m2r));
+        __m128i vg = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m0g), _mm_shuffle_epi8(bb, m1g)), _mm_shuffle_epi8(cc, m2g));
+        __m128i vb = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m0b), _mm_shuffle_epi8(bb, m1b)), _mm_shuffle_epi8(cc, m2b));
+        _mm_storeu_si128((__m128i *)(r + i), vr);
+        _mm_storeu_si128((__m128i *)(g + i), vg);
+        _mm_storeu_si128((__m128i *)(b + i), vb);
+    }
+    return i;
+}
+#endif
+
+static void deinterleave3(const unsigned char *src, unsigned char *r, unsigned char *g, unsigned char *b, size_t n)
+{
+    size_t i = 0;
+#if PLANAR_SSSE3
+    if (has_ssse3())
+        i = deinterleave3_ssse3(src, r, g, b, n);
+#endif
+    for (; i < n; ++i)
+    {
+        r[i] = src[i * 3];
+        g[i] = src[i * 3 + 1];
+        b[i] = src[i * 3 + 2];
+    }
+}
+
+#if PLANAR_SSSE3
+/** 三個平面 → RGB 交錯（SSSE3）；回傳處理到的像素數 */
+SSSE3_FN static size_t interleave3_ssse3(const unsigned char *r, const unsigned char *g, const unsigned char *b,
+                                         unsigned char *dst, size_t n)
+{
+    size_t i = 0;
+    const __m128i r0 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+    const __m128i g0 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+    const __m128i b0 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+    const __m128i r1 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+    const __m128i g1 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+    const __m128i b1 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+    const __m128i r2 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+    const __m128i g2 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+    const __m128i b2 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i vr = _mm_loadu_si128((const __m128i *)(r + i));
+        __m128i vg = _mm_loadu_si128((const __m128i *)(g + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i o0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vr, r0), _mm_shuffle_epi8(vg, g0)), _mm_shuffle_epi8(vb, b0));
+        __m128i o1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vr, r1), _mm_shuffle_epi8(vg, g1)), _mm_shuffle_epi8(vb, b1));
+        __m128i o2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(vr, r2), _mm_shuffle_epi8(vg, g2)), _mm_shuffle_epi8(vb, b2));
+        _mm_storeu_si128((__m128i *)(dst + i * 3), o0);
+        _mm_storeu_si128((__m128i *)(dst + i * 3 + 16), o1);
+        _mm_storeu_si128((__m128i *)(dst + i * 3 + 32), o2);
+    }
+    return i;
+}
+#endif
+
+static void interleave3(const unsigned char *r, const unsigned char *g, const unsigned char *b, unsigned char *dst, size_t n)
+{
+    size_t i = 0;
+#if PLANAR_SSSE3
+    if (has_ssse3())
+        i = interleave3_ssse3(r, g, b, dst, n);
+#endif
+    for (; i < n; ++i)
+    {
+        dst[i * 3] = r[i];
+        dst[i * 3 + 1] = g[i];
+        dst[i * 3 + 2] = b[i];
+    }
+}
+
+PlanarImage *to_planar(const Image *img)
+{
+    PlanarImage *p = create_planar(img->w, img->h, img->c);
+    if (!p)
+        return NULL;
+    size_t n = (size_t)img->w * img->h;
+    if (img->c == 1)
+        memcpy(p->plane[0], img->data, n);
+    else if (img->c == 3)
+        deinterleave3(img->data, p->plane[0], p->plane[1], p->plane[2], n);
+    else
+    {
+        for (size_t i = 0; i < n; ++i)
+            for (int ch = 0; ch < img->c; ++ch)
+                p->plane[ch][i] = img->data[i * img->c + ch];
+    }
+    return p;
+}
+
+/** 交錯寫回呼叫端的 Image（例如平面原本就是由它拆出來的），尺寸不符回傳 0 */
+int from_planar_into(const PlanarImage *p, Image *img)
+{
+    if (img->w != p->w || img->h != p->h || img->c != p->c || img->type != PIXEL_U8)
+        return 0;
+    size_t n = (size_t)p->w * p->h;
+    if (p->c == 1)
+        memcpy(img->data, p->plane[0], n);
+    else if (p->c == 3)
+        interleave3(p->plane[0], p->plane[1], p->plane[2], img->data, n);
+    else
+    {
+        for (size_t i = 0; i < n; ++i)
+            for (int ch = 0; ch < p->c; ++ch)
+                img->data[i * p->c + ch] = p->plane[ch][i];
+    }
+    return 1;
+}
+
+Image *from_planar(const PlanarImage *p)
+{
+    Image *img = create_image(p->w, p->h, p->c);
+    from_planar_into(p, img);
+    return img;
+}
+
+typedef struct
+{
+    const PlanarImage *src;
+    PlaneOp op;
+    const void *arg;
+    Image *res[PLANAR_MAX_CHANNELS];
+} PlaneJob;
+
+static void plane_band(void *arg, int ch0, int ch1)
+{
+    PlaneJob *job = (PlaneJob *)arg;
+    for (int ch = ch0; ch < ch1; ++ch)
+    {
+        Image v = planar_view(job->src, ch);
+        job->res[ch] = job->op(&v, job->arg);
+    }
+}
+
+/** 對每個平面各自執行 op（op 輸出單通道 8-bit Image），parallel 時每個通道是預設排程器上的一個 band。
+ *  任一通道失敗或輸出尺寸不一致時整體失敗，回傳 NULL */
+PlanarImage *planar_apply(const PlanarImage *src, PlaneOp op, const void *arg, int parallel)
+{
+    PlaneJob job = {src, op, arg, {NULL}};
+    sched_parallel_for(parallel ? sched_default() : NULL, 0, src->c, 1, plane_band, &job);
+
+    const Image *r0 = job.res[0];
+    int ok = r0 != NULL;
+    for (int ch = 0; ch < src->c; ++ch)
+    {
+        const Image *r = job.res[ch];
+        if (!ok || !r || r->c != 1 || r->type != PIXEL_U8 || r->w != r0->w || r->h != r0->h)
+            ok = 0;
+    }
+    PlanarImage *out = ok ? create_planar(r0->w, r0->h, src->c) : NULL;
+    for (int ch = 0; ch < src->c; ++ch)
+        if (out)
+            memcpy(out->plane[ch], job.res[ch]->data, (size_t)out->w * out->h);
+    for (int ch = 0; ch < src->c; ++ch)
+        free_image(job.res[ch]);
+    return out;
+}
@@ -0,0 +1,216 @@
+// Buffer pool.
+// 每個區塊前面有一個 64 位元組的標頭記錄容量，因此 free/realloc 不需要呼叫端提供大小；
+// 大於 POOL_MIN 的區塊以頁為單位取整並依容量放進 free list，批次處理同尺寸影像時
+// 穩定狀態下不再呼叫 malloc。
+
+#define _POSIX_C_SOURCE 200809L
+#include "pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define POOL_ALIGN 64
+#define POOL_PAGE 4096
+#define POOL_MIN 16384 // 小於此大小直接走 malloc（stb 的表格、zlib 狀態等）
+#define POOL_BINS 32
+
+typedef struct Block
+{
+    size_t cap; // 不含標頭的容量
+    int pooled; // 0 表示小區塊，free 時直接還給系統
+    struct Block *next;
+} Block;
+
+typedef struct
+{
+    size_t cap;
+    Block *head;
+} Bin;
+
+struct BufferPool
+{
+    pthread_mutex_t lock;
+    Bin bins[POOL_BINS];
+    size_t max_cached;
+    size_t cached, live, peak;
+    long allocs, hits;
+};
+
+static Block *header_of(void *ptr)
+{
+    return (Block *)((unsigned char *)ptr - POOL_ALIGN);
+}
+
+static void *payload_of(Block *b)
+{
+    return (unsigned char *)b + POOL_ALIGN;
+}
+
+static Block *raw_alloc(size_t cap)
+{
+    void *mem = NULL;
+    if (posix_memalign(&mem, POOL_ALIGN, cap + POOL_ALIGN) != 0)
+        return NULL;
+    Block *b = (Block *)mem;
+    b->cap = cap;
+    b->pooled = 1;
+    b->next = NULL;
+    return b;
+}
+
+BufferPool *pool_create(size_t max_cached)
+{
+    BufferPool *p = (BufferPool *)calloc(1, sizeof(BufferPool));
+    pthread_mutex_init(&p->lock, NULL);
+    p->max_cached = max_cached;
+    return p;
+}
+
+void pool_trim(BufferPool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    for (int i = 0; i < POOL_BINS; ++i)
+    {
+        while (p->bins[i].head)
+        {
+            Block *b = p->bins[i].head;
+            p->bins[i].head = b->next;
+            free(b);
+        }
+        p->bins[i].cap = 0;
+    }
+    p->cached = 0;
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_destroy(BufferPool *p)
+{
+    if (!p)
+        return;
+    pool_trim(p);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
+
+/** 找容量剛好為 cap 的 bin；create 時沒有就挑一個空的（全滿回傳 NULL） */
+static Bin *find_bin(BufferPool *p, size_t cap, int create)
+{
+    Bin *empty = NULL;
+    for (int i = 0; i < POOL_BINS; ++i)
+    {
+        if (p->bins[i].cap == cap)
+            return &p->bins[i];
+        if (!empty && !p->bins[i].head)
+            empty = &p->bins[i];
+    }
+    if (!create || !empty)
+        return NULL;
+    empty->cap = cap;
+    return empty;
+}
+
+void *pool_alloc(BufferPool *p, size_t n)
+{
+    if (n < POOL_MIN)
+    {
+        Block *b = raw_alloc(n);
+        if (!b)
+            return NULL;
+        b->pooled = 0;
+        return payload_of(b);
+    }
+    size_t cap = (n + POOL_PAGE - 1) / POOL_PAGE * POOL_PAGE;
+    Block *b = NULL;
+    pthread_mutex_lock(&p->lock);
+    p->allocs++;
+    Bin *bin = find_bin(p, cap, 0);
+    if (bin && bin->head)
+    {
+        b = bin->head;
+        bin->head = b->next;
+        p->cached -= cap;
+        p->hits++;
+    }
+    p->live += cap;
+    if (p->live > p->peak)
+        p->peak = p->live;
+    pthread_mutex_unlock(&p->lock);
+    if (!b)
+        b = raw_alloc(cap);
+    return b ? payload_of(b) : NULL;
+}
+
+void pool_free(BufferPool *p, void *ptr)
+{
+    if (!ptr)
+        return;
+    Block *b = header_of(ptr);
+    if (!b->pooled)
+    {
+        free(b);
+        return;
+    }
+    pthread_mutex_lock(&p->lock);
+    p->live -= b->cap;
+    Bin *bin = p->cached + b->cap <= p->max_cached ? find_bin(p, b->cap, 1) : NULL;
+    if (bin)
+    {
+        b->next = bin->head;
+        bin->head = b;
+        p->cached += b->cap;
+        b = NULL;
+    }
+    pthread_mutex_unlock(&p->lock);
+    free(b);
+}
+
+void *pool_realloc(BufferPool *p, void *ptr, size_t n)
+{
+    if (!ptr)
+        return pool_alloc(p, n);
+    Block *b = header_of(ptr);
+    if (b->pooled && b->cap >= n)
+        return ptr;
+    void *fresh = pool_alloc(p, n);
+    if (fresh)
+    {
+        memcpy(fresh, ptr, b->cap < n ? b->cap : n);
+        pool_free(p, ptr);
+    }
+    return fresh;
+}
+
+void pool_stats(BufferPool *p, PoolStats *out)
+{
+    pthread_mutex_lock(&p->lock);
+    out->allocs = p->allocs;
+    out->hits = p->hits;
+    out->cached_bytes = p->cached;
+    out->peak_bytes = p->peak;
+    pthread_mutex_unlock(&p->lock);
+}
+
+void pool_print_stats(BufferPool *p)
+{
+    PoolStats st;
+    pool_stats(p, &st);
+    printf("buffer pool: %ld allocs, %ld reused (%.0f%%), peak %.1f MB, cached %.1f MB\n", st.allocs, st.hits,
+           st.allocs ? 100.0 * st.hits / st.allocs : 0.0, st.peak_bytes / 1048576.0, st.cached_bytes / 1048576.0);
+}
+
+#define IMAGE_POOL_CACHE ((size_t)256 << 20)
+
+static BufferPool *image_pool_ptr;
+static pthread_once_t image_pool_once = PTHREAD_ONCE_INIT;
+
+static void image_pool_init(void)
+{
+    image_pool_ptr = pool_create(IMAGE_POOL_CACHE);
+}
+
+BufferPool *image_pool(void)
+{
+    pthread_once(&image_pool_once, image_pool_init);
+    return image_pool_ptr;
+}
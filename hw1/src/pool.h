@@ -0,0 +1,35 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Recycling allocator for pixel buffers (pool.c).
+// Blocks are 64-byte aligned and rounded up to whole pages; freed blocks are
+// kept per size so the next image of the same size reuses them instead of
+// going back to malloc. Small requests pass straight through to malloc.
+
+typedef struct BufferPool BufferPool;
+
+typedef struct
+{
+    long allocs;         // pool_alloc / pool_realloc calls that needed a block
+    long hits;           // served from a cached block
+    size_t cached_bytes; // held in free lists right now
+    size_t peak_bytes;   // most bytes handed out at once (pooled blocks only)
+} PoolStats;
+
+BufferPool *pool_create(size_t max_cached); // bytes kept in free lists before returning to the system
+void pool_destroy(BufferPool *p);
+
+void *pool_alloc(BufferPool *p, size_t n);
+void *pool_realloc(BufferPool *p, void *ptr, size_t n);
+void pool_free(BufferPool *p, void *ptr);
+void pool_trim(BufferPool *p); // release every cached block
+
+void pool_stats(BufferPool *p, PoolStats *out);
+void pool_print_stats(BufferPool *p);
+
+// process-wide pool behind Image data and the stb allocation hooks
+BufferPool *image_pool(void);
+
+#endif
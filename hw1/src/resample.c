@@ -0,0 +1,343 @@
+// Separable filter resizing (bicubic / lanczos3 / mitchell)
+// 每個軸的 contribution list（來源起點、權重）只跟 (src, dst, filter) 有關，
+// 因此計算一次後放進 cache，重複縮到相同尺寸時可以跳過設定。
+
+#include "image.h"
+#include "sched.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct
+{
+    int src_n, dst_n;
+    ResizeFilter filter;
+    int stride;     // 每個輸出像素保留的權重數（= 最大 tap 數）
+    int *first;     // 第 i 個輸出像素的第一個來源索引
+    int *count;     // 實際 tap 數
+    float *weights; // dst_n * stride
+    unsigned long stamp;
+    int refs;
+    int evicted;
+} Contrib;
+
+#define CONTRIB_CACHE_SIZE 16
+
+static Contrib *contrib_cache[CONTRIB_CACHE_SIZE];
+static unsigned long contrib_clock;
+static pthread_mutex_t contrib_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct
+{
+    const char *name;
+    ResizeFilter filter;
+    double support;
+} filter_table[] = {
+    {"bicubic", FILTER_BICUBIC, 2.0},
+    {"lanczos3", FILTER_LANCZOS3, 3.0},
+    {"mitchell", FILTER_MITCHELL, 2.0},
+};
+
+int resize_filter_from_name(const char *name, ResizeFilter *out)
+{
+    for (size_t i = 0; i < sizeof(filter_table) / sizeof(filter_table[0]); ++i)
+    {
+        if (strcmp(name, filter_table[i].name) == 0)
+        {
+            *out = filter_table[i].filter;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static double filter_support(ResizeFilter f)
+{
+    return filter_table[f].support;
+}
+
+/** Keys cubic 與 Mitchell-Netravali 共用的 (B, C) 形式 */
+static double cubic_bc(double x, double B, double C)
+{
+    x = fabs(x);
+    if (x < 1.0)
+        return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6.0;
+    if (x < 2.0)
+        return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6.0;
+    return 0.0;
+}
+
+static double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static double filter_eval(ResizeFilter f, double x)
+{
+    switch (f)
+    {
+    case FILTER_BICUBIC:
+        return cubic_bc(x, 0.0, 0.5);
+    case FILTER_MITCHELL:
+        return cubic_bc(x, 1.0 / 3.0, 1.0 / 3.0);
+    case FILTER_LANCZOS3:
+        return fabs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+/** 建立單一軸的 contribution list；縮小時把 filter 拉寬 src/dst 倍（support-aware） */
+static Contrib *contrib_build(int src_n, int dst_n, ResizeFilter f)
+{
+    double scale = (double)src_n / dst_n;
+    double fscale = scale > 1.0 ? scale : 1.0;
+    double support = filter_support(f) * fscale;
+    int stride = (int)ceil(support) * 2 + 1;
+
+    Contrib *ct = (Contrib *)calloc(1, sizeof(Contrib));
+    ct->src_n = src_n;
+    ct->dst_n = dst_n;
+    ct->filter = f;
+    ct->stride = stride;
+    ct->first = (int *)malloc(sizeof(int) * dst_n);
+    ct->count = (int *)malloc(sizeof(int) * dst_n);
+    ct->weights = (float *)calloc((size_t)dst_n * stride, sizeof(float));
+
+    double *tmp = (double *)malloc(sizeof(double) * stride);
+    for (int i = 0; i < dst_n; ++i)
+    {
+        double center = (i + 0.5) * scale - 0.5;
+        int lo = (int)floor(center - support) + 1;
+        int hi = (int)floor(center + support);
+        // 超出邊界的 tap 併入邊緣像素（等同 clamp）
+        int a = lo < 0 ? 0 : lo;
+        int b = hi >= src_n ? src_n - 1 : hi;
+        if (a > src_n - 1)
+            a = src_n - 1;
+        if (b < a)
+            b = a;
+        if (b - a + 1 > stride)
+            b = a + stride - 1;
+        int n = b - a + 1;
+        memset(tmp, 0, sizeof(double) * stride);
+        double sum = 0.0;
+        for (int j = lo; j <= hi; ++j)
+        {
+            double w = filter_eval(f, (j - center) / fscale);
+            int k = j < a ? a : (j > b ? b : j);
+            tmp[k - a] += w;
+            sum += w;
+        }
+        if (sum == 0.0)
+        {
+            tmp[0] = 1.0;
+            sum = 1.0;
+        }
+        ct->first[i] = a;
+        ct->count[i] = n;
+        for (int k = 0; k < n; ++k)
+            ct->weights[(size_t)i * stride + k] = (float)(tmp[k] / sum);
+    }
+    free(tmp);
+    return ct;
+}
+
+static void contrib_free(Contrib *ct)
+{
+    free(ct->first);
+    free(ct->count);
+    free(ct->weights);
+    free(ct);
+}
+
+/** 從 cache 取得 contribution list（沒有就建立），使用完須呼叫 contrib_release */
+static Contrib *contrib_acquire(int src_n, int dst_n, ResizeFilter f)
+{
+    pthread_mutex_lock(&contrib_lock);
+    int victim = 0;
+    for (int i = 0; i < CONTRIB_CACHE_SIZE; ++i)
+    {
+        Contrib *ct = contrib_cache[i];
+        if (ct && ct->src_n == src_n && ct->dst_n == dst_n && ct->filter == f)
+        {
+            ct->stamp = ++contrib_clock;
+            ct->refs++;
+            pthread_mutex_unlock(&contrib_lock);
+            return ct;
+        }
+        if (!ct)
+            victim = i;
+        else if (contrib_cache[victim] && ct->stamp < contrib_cache[victim]->stamp)
+            victim = i;
+    }
+    pthread_mutex_unlock(&contrib_lock);
+
+    Contrib *fresh = contrib_build(src_n, dst_n, f);
+
+    pthread_mutex_lock(&contrib_lock);
+    Contrib *old = contrib_cache[victim];
+    if (old)
+    {
+        if (old->refs == 0)
+            contrib_free(old);
+        else
+            old->evicted = 1;
+    }
+    fresh->stamp = ++contrib_clock;
+    fresh->refs = 1;
+    contrib_cache[victim] = fresh;
+    pthread_mutex_unlock(&contrib_lock);
+    return fresh;
+}
+
+static void contrib_release(Contrib *ct)
+{
+    pthread_mutex_lock(&contrib_lock);
+    ct->refs--;
+    int dead = ct->evicted && ct->refs == 0;
+    pthread_mutex_unlock(&contrib_lock);
+    if (dead)
+        contrib_free(ct);
+}
+
+void resize_filter_cache_clear(void)
+{
+    pthread_mutex_lock(&contrib_lock);
+    for (int i = 0; i < CONTRIB_CACHE_SIZE; ++i)
+    {
+        Contrib *ct = contrib_cache[i];
+        if (!ct)
+            continue;
+        if (ct->refs == 0)
+            contrib_free(ct);
+        else
+            ct->evicted = 1;
+        contrib_cache[i] = NULL;
+    }
+    pthread_mutex_unlock(&contrib_lock);
+}
+
+/** 水平方向：一列 uint8 → out_w*c 個 float */
+static void filter_row_h(const unsigned char *src, float *dst, int c, const Contrib *cx)
+{
+    for (int x = 0; x < cx->dst_n; ++x)
+    {
+        const float *w = &cx->weights[(size_t)x * cx->stride];
+        const unsigned char *p = &src[(size_t)cx->first[x] * c];
+        for (int ch = 0; ch < c; ++ch)
+        {
+            float s = 0.0f;
+            for (int k = 0; k < cx->count[x]; ++k)
+                s += w[k] * p[k * c + ch];
+            dst[x * c + ch] = s;
+        }
+    }
+}
+
+/** 垂直方向：把 count 列中間結果加權相加並量化成 uint8（SSE2 一次處理 4 個 float） */
+static void filter_col_v(float *const *rows, const float *w, int count, int n, float *acc, unsigned char *dst)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 s = _mm_setzero_ps();
+        for (int k = 0; k < count; ++k)
+            s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(rows[k] + i)));
+        _mm_storeu_ps(acc + i, s);
+    }
+    for (int j = 0; j + 16 <= i; j += 16)
+    {
+        __m128i a = _mm_cvtps_epi32(_mm_loadu_ps(acc + j));
+        __m128i b = _mm_cvtps_epi32(_mm_loadu_ps(acc + j + 4));
+        __m128i cc = _mm_cvtps_epi32(_mm_loadu_ps(acc + j + 8));
+        __m128i d = _mm_cvtps_epi32(_mm_loadu_ps(acc + j + 12));
+        __m128i ab = _mm_packs_epi32(a, b);
+        __m128i cd = _mm_packs_epi32(cc, d);
+        _mm_storeu_si128((__m128i *)(dst + j), _mm_packus_epi16(ab, cd));
+    }
+    for (int j = i & ~15; j < i; ++j)
+    {
+        int v = (int)lrintf(acc[j]);
+        dst[j] = (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+#else
+    (void)acc;
+#endif
+    for (; i < n; ++i)
+    {
+        float s = 0.0f;
+        for (int k = 0; k < count; ++k)
+            s += w[k] * rows[k][i];
+        int v = (int)lrintf(s);
+        dst[i] = (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+}
+
+typedef struct
+{
+    const Image *in;
+    Image *out;
+    const Contrib *cx, *cy;
+    float *tmp; // img->h 列的水平 pass 結果
+    size_t row_n;
+} FilterBand;
+
+static void filter_band_h(void *arg, int y0, int y1)
+{
+    FilterBand *b = (FilterBand *)arg;
+    int c = b->in->c;
+    for (int y = y0; y < y1; ++y)
+        filter_row_h(&b->in->data[(size_t)y * b->in->w * c], &b->tmp[y * b->row_n], c, b->cx);
+}
+
+static void filter_band_v(void *arg, int y0, int y1)
+{
+    FilterBand *b = (FilterBand *)arg;
+    const Contrib *cy = b->cy;
+    float **rows = (float **)malloc(sizeof(float *) * cy->stride);
+    float *acc = (float *)malloc(sizeof(float) * b->row_n);
+    for (int y = y0; y < y1; ++y)
+    {
+        for (int k = 0; k < cy->count[y]; ++k)
+            rows[k] = &b->tmp[(size_t)(cy->first[y] + k) * b->row_n];
+        filter_col_v(rows, &cy->weights[(size_t)y * cy->stride], cy->count[y], (int)b->row_n,
+                     acc, &b->out->data[(size_t)y * b->row_n]);
+    }
+    free(acc);
+    free(rows);
+}
+
+Image *resize_filter(const Image *img, int out_w, int out_h, ResizeFilter f)
+{
+    Contrib *cx = contrib_acquire(img->w, out_w, f);
+    Contrib *cy = contrib_acquire(img->h, out_h, f);
+    Image *out = create_image(out_w, out_h, img->c);
+
+    FilterBand b;
+    b.in = img;
+    b.out = out;
+    b.cx = cx;
+    b.cy = cy;
+    b.row_n = (size_t)out_w * img->c;
+    // 先做所有來源列的水平 pass，再逐輸出列做垂直 pass，兩段各自切成 row band 平行
+    b.tmp = (float *)malloc(sizeof(float) * b.row_n * img->h);
+    int grain = (int)(16384 / b.row_n) + 1;
+    sched_parallel_for(sched_default(), 0, img->h, grain, filter_band_h, &b);
+    sched_parallel_for(sched_default(), 0, out_h, grain, filter_band_v, &b);
+    free(b.tmp);
+    contrib_release(cx);
+    contrib_release(cy);
+    return out;
+}
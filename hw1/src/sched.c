@@ -0,0 +1,383 @@
+// Work-stealing scheduler.
+// 每個 worker 有自己的 deque（ring buffer + mutex）；自己從底端 push/pop（LIFO，
+// cache 較熱），沒事做時從其他 worker 的頂端偷（FIFO，通常是較大的工作）。
+
+#define _POSIX_C_SOURCE 200809L
+#include "sched.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct
+{
+    TaskFn fn;
+    void *arg;
+    atomic_int *pending; // 完成時遞減（join 用），可為 NULL
+} Task;
+
+typedef struct
+{
+    Task *buf;
+    int cap;
+    long head, tail; // [head, tail) 為佇列內容；head 給偷取端，tail 給擁有者
+    pthread_mutex_t lock;
+} Deque;
+
+struct Scheduler
+{
+    int n;
+    Deque *q;
+    pthread_t *tids;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond; // 有新工作或有工作群組完成時 broadcast
+    atomic_int queued;
+    atomic_int outstanding; // sched_submit 送出但尚未完成的工作
+    atomic_int stop;
+    atomic_uint rr;
+    atomic_long tasks, steals;
+    atomic_int max_depth;
+};
+
+static _Thread_local Scheduler *tls_sched;
+static _Thread_local int tls_worker = -1;
+static _Thread_local unsigned tls_seed = 1;
+
+static Scheduler *default_sched;
+
+int sched_cpu_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void deque_push(Scheduler *s, Deque *d, Task t)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->tail - d->head == d->cap)
+    {
+        int ncap = d->cap * 2;
+        Task *nb = (Task *)malloc(sizeof(Task) * ncap);
+        for (long i = d->head; i < d->tail; ++i)
+            nb[i % ncap] = d->buf[i % d->cap];
+        free(d->buf);
+        d->buf = nb;
+        d->cap = ncap;
+    }
+    d->buf[d->tail % d->cap] = t;
+    d->tail++;
+    int depth = (int)(d->tail - d->head);
+    pthread_mutex_unlock(&d->lock);
+
+    int cur = atomic_load(&s->max_depth);
+    while (depth > cur && !atomic_compare_exchange_weak(&s->max_depth, &cur, depth))
+        ;
+}
+
+static int deque_pop(Deque *d, Task *t)
+{
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head)
+    {
+        d->tail--;
+        *t = d->buf[d->tail % d->cap];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static int deque_steal(Deque *d, Task *t)
+{
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head)
+    {
+        *t = d->buf[d->head % d->cap];
+        d->head++;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+/** 取出最靠近底端、屬於 group（pending 相同）的工作，後面的工作往前補位。
+ *  群組的工作通常就在底端；外部執行緒輪流放進來的工作可能壓在上面，因此整條掃描 */
+static int deque_take_group(Deque *d, Task *t, const atomic_int *group)
+{
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    for (long i = d->tail - 1; i >= d->head; --i)
+    {
+        if (d->buf[i % d->cap].pending != group)
+            continue;
+        *t = d->buf[i % d->cap];
+        for (long j = i; j + 1 < d->tail; ++j)
+            d->buf[j % d->cap] = d->buf[(j + 1) % d->cap];
+        d->tail--;
+        ok = 1;
+        break;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static void wake_all(Scheduler *s)
+{
+    pthread_mutex_lock(&s->idle_lock);
+    pthread_cond_broadcast(&s->idle_cond);
+    pthread_mutex_unlock(&s->idle_lock);
+}
+
+/** 放進自己的 deque；外部執行緒則輪流放進各 worker 的 deque */
+static void push_task(Scheduler *s, Task t)
+{
+    int i = (tls_sched == s && tls_worker >= 0) ? tls_worker : (int)(atomic_fetch_add(&s->rr, 1) % s->n);
+    deque_push(s, &s->q[i], t);
+    atomic_fetch_add(&s->queued, 1);
+    wake_all(s);
+}
+
+/** 先拿自己的，沒有再從隨機起點輪流偷別人的；group 不為 NULL 時只取該群組的工作 */
+static int find_task(Scheduler *s, Task *t, const atomic_int *group)
+{
+    int self = (tls_sched == s) ? tls_worker : -1;
+    if (self >= 0 && (group ? deque_take_group(&s->q[self], t, group) : deque_pop(&s->q[self], t)))
+    {
+        atomic_fetch_sub(&s->queued, 1);
+        return 1;
+    }
+    tls_seed = tls_seed * 1103515245u + 12345u;
+    int start = (int)((tls_seed >> 16) % (unsigned)s->n);
+    for (int k = 0; k < s->n; ++k)
+    {
+        int v = (start + k) % s->n;
+        if (v == self)
+            continue;
+        if (group ? deque_take_group(&s->q[v], t, group) : deque_steal(&s->q[v], t))
+        {
+            atomic_fetch_sub(&s->queued, 1);
+            atomic_fetch_add(&s->steals, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void run_task(Scheduler *s, Task *t)
+{
+    t->fn(t->arg);
+    atomic_fetch_add(&s->tasks, 1);
+    if (t->pending && atomic_fetch_sub(t->pending, 1) == 1)
+        wake_all(s);
+}
+
+static void *worker_main(void *arg)
+{
+    Scheduler *s = (Scheduler *)arg;
+    Task t;
+    for (;;)
+    {
+        if (find_task(s, &t, NULL))
+        {
+            run_task(s, &t);
+            continue;
+        }
+        pthread_mutex_lock(&s->idle_lock);
+        while (!atomic_load(&s->stop) && atomic_load(&s->queued) == 0)
+            pthread_cond_wait(&s->idle_cond, &s->idle_lock);
+        int stop = atomic_load(&s->stop) && atomic_load(&s->queued) == 0;
+        pthread_mutex_unlock(&s->idle_lock);
+        if (stop)
+            break;
+    }
+    return NULL;
+}
+
+typedef struct
+{
+    Scheduler *s;
+    int id;
+} WorkerArg;
+
+static void *worker_entry(void *arg)
+{
+    WorkerArg wa = *(WorkerArg *)arg;
+    free(arg);
+    tls_sched = wa.s;
+    tls_worker = wa.id;
+    tls_seed = (unsigned)wa.id * 2654435761u + 1u;
+    return worker_main(wa.s);
+}
+
+Scheduler *sched_create(int workers)
+{
+    if (workers < 1)
+        workers = sched_cpu_count();
+    Scheduler *s = (Scheduler *)calloc(1, sizeof(Scheduler));
+    s->n = workers;
+    s->q = (Deque *)calloc(workers, sizeof(Deque));
+    s->tids = (pthread_t *)malloc(sizeof(pthread_t) * workers);
+    pthread_mutex_init(&s->idle_lock, NULL);
+    pthread_cond_init(&s->idle_cond, NULL);
+    for (int i = 0; i < workers; ++i)
+    {
+        s->q[i].cap = 64;
+        s->q[i].buf = (Task *)malloc(sizeof(Task) * s->q[i].cap);
+        pthread_mutex_init(&s->q[i].lock, NULL);
+    }
+    for (int i = 0; i < workers; ++i)
+    {
+        WorkerArg *wa = (WorkerArg *)malloc(sizeof(WorkerArg));
+        wa->s = s;
+        wa->id = i;
+        pthread_create(&s->tids[i], NULL, worker_entry, wa);
+    }
+    return s;
+}
+
+void sched_destroy(Scheduler *s)
+{
+    if (!s)
+        return;
+    sched_wait(s);
+    atomic_store(&s->stop, 1);
+    wake_all(s);
+    for (int i = 0; i < s->n; ++i)
+        pthread_join(s->tids[i], NULL);
+    for (int i = 0; i < s->n; ++i)
+    {
+        free(s->q[i].buf);
+        pthread_mutex_destroy(&s->q[i].lock);
+    }
+    pthread_mutex_destroy(&s->idle_lock);
+    pthread_cond_destroy(&s->idle_cond);
+    if (default_sched == s)
+        default_sched = NULL;
+    free(s->q);
+    free(s->tids);
+    free(s);
+}
+
+void sched_submit(Scheduler *s, TaskFn fn, void *arg)
+{
+    atomic_fetch_add(&s->outstanding, 1);
+    Task t = {fn, arg, &s->outstanding};
+    push_task(s, t);
+}
+
+/** 等到 *pending 歸零；等待期間只幫忙執行同一群組的工作（own_group）或任何工作。
+ *  join 時若也拿其他工作，worker 可能在 band 尚未完成時把整個 batch job 疊在自己的 stack 上，
+ *  巢狀深度與記憶體用量會隨 batch 大小成長 */
+static void help_until(Scheduler *s, atomic_int *pending, int own_group)
+{
+    Task t;
+    while (atomic_load(pending) > 0)
+    {
+        if (find_task(s, &t, own_group ? pending : NULL))
+        {
+            run_task(s, &t);
+            continue;
+        }
+        pthread_mutex_lock(&s->idle_lock);
+        if (own_group)
+        {
+            // 群組剩下的工作都在別的 worker 上執行：等群組完成（run_task 會 broadcast），
+            // 佇列中其他的工作不算數
+            if (atomic_load(pending) > 0)
+                pthread_cond_wait(&s->idle_cond, &s->idle_lock);
+        }
+        else
+        {
+            while (atomic_load(pending) > 0 && atomic_load(&s->queued) == 0)
+                pthread_cond_wait(&s->idle_cond, &s->idle_lock);
+        }
+        pthread_mutex_unlock(&s->idle_lock);
+    }
+}
+
+void sched_wait(Scheduler *s)
+{
+    help_until(s, &s->outstanding, 0);
+}
+
+typedef struct
+{
+    RangeFn fn;
+    void *arg;
+    int begin, end;
+} RangeTask;
+
+static void range_task_run(void *arg)
+{
+    RangeTask *r = (RangeTask *)arg;
+    r->fn(r->arg, r->begin, r->end);
+}
+
+void sched_parallel_for(Scheduler *s, int begin, int end, int grain, RangeFn fn, void *arg)
+{
+    if (grain < 1)
+        grain = 1;
+    int n = (end - begin + grain - 1) / grain;
+    if (!s || n <= 1)
+    {
+        if (end > begin)
+            fn(arg, begin, end);
+        return;
+    }
+
+    RangeTask *bands = (RangeTask *)malloc(sizeof(RangeTask) * n);
+    atomic_int pending;
+    atomic_init(&pending, n - 1);
+    for (int i = 0; i < n; ++i)
+    {
+        bands[i].fn = fn;
+        bands[i].arg = arg;
+        bands[i].begin = begin + i * grain;
+        bands[i].end = bands[i].begin + grain < end ? bands[i].begin + grain : end;
+    }
+    // 由後往前 push，擁有者 pop 時會先拿到前面的 band
+    for (int i = n - 1; i >= 1; --i)
+    {
+        Task t = {range_task_run, &bands[i], &pending};
+        push_task(s, t);
+    }
+    range_task_run(&bands[0]);
+    help_until(s, &pending, 1);
+    free(bands);
+}
+
+void sched_stats(Scheduler *s, SchedStats *out)
+{
+    out->workers = s->n;
+    out->tasks = atomic_load(&s->tasks);
+    out->steals = atomic_load(&s->steals);
+    out->queue_depth = atomic_load(&s->queued);
+    out->max_queue_depth = atomic_load(&s->max_depth);
+}
+
+void sched_set_default(Scheduler *s)
+{
+    default_sched = s;
+}
+
+Scheduler *sched_default(void)
+{
+    return default_sched;
+}
+
+/** band 數約為預設排程器 worker 數的四倍：夠平衡負載，每個 band 的部分結果合併起來也不貴 */
+int sched_band_rows(int h)
+{
+    int n = 1;
+    if (default_sched)
+    {
+        SchedStats ss;
+        sched_stats(default_sched, &ss);
+        n = ss.workers * 4;
+    }
+    if (n > h)
+        n = h;
+    return n > 0 ? (h + n - 1) / n : 1;
+}
@@ -0,0 +1,45 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+// Work-stealing task scheduler (sched.c).
+// Each worker owns a deque: it pushes and pops its own tasks at the bottom,
+// idle workers steal from the top of other deques. Tasks may spawn subtasks
+// with sched_parallel_for, which runs its own queued bands while it waits
+// (never unrelated tasks, so joins do not nest whole jobs on the stack).
+
+typedef void (*TaskFn)(void *arg);
+typedef void (*RangeFn)(void *arg, int begin, int end);
+
+typedef struct Scheduler Scheduler;
+
+typedef struct
+{
+    int workers;
+    long tasks;          // tasks executed
+    long steals;         // tasks taken from another worker's deque
+    int queue_depth;     // tasks currently queued
+    int max_queue_depth; // deepest single deque seen
+} SchedStats;
+
+Scheduler *sched_create(int workers);
+void sched_destroy(Scheduler *s); // waits for outstanding tasks
+
+void sched_submit(Scheduler *s, TaskFn fn, void *arg);
+void sched_wait(Scheduler *s); // until every submitted task has finished
+
+// split [begin, end) into bands of about `grain` and run them in parallel;
+// s == NULL (or a single band) runs fn(arg, begin, end) on the caller
+void sched_parallel_for(Scheduler *s, int begin, int end, int grain, RangeFn fn, void *arg);
+
+void sched_stats(Scheduler *s, SchedStats *out);
+
+// process-wide scheduler used by the image kernels (NULL = serial)
+void sched_set_default(Scheduler *s);
+Scheduler *sched_default(void);
+// band height for splitting h rows into about 4 bands per default worker, for
+// kernels that keep one partial result per band (index y0 / rows)
+int sched_band_rows(int h);
+
+int sched_cpu_count(void);
+
+#endif
@@ -0,0 +1,417 @@
+// Tiled image storage and tile-parallel processing.
+// 影像切成 tile×tile 的區塊分別配置；區塊在第一次被存取時才載入或計算，
+// 因此只處理 ROI 時不需要讀入整張影像。
+
+#define _XOPEN_SOURCE 700
+#include "tile.h"
+#include "kernels.h"
+#include "bmp.h"
+#include "sched.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+TiledImage *create_tiled(int w, int h, int c, int tile)
+{
+    if (tile <= 0)
+        tile = TILE_DEFAULT;
+    TiledImage *t = (TiledImage *)calloc(1, sizeof(TiledImage));
+    t->w = w;
+    t->h = h;
+    t->c = c;
+    t->tile = tile;
+    t->nx = (w + tile - 1) / tile;
+    t->ny = (h + tile - 1) / tile;
+    int n = t->nx * t->ny;
+    t->tiles = (unsigned char **)calloc(n, sizeof(unsigned char *));
+    t->locks = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t) * n);
+    for (int i = 0; i < n; ++i)
+        pthread_mutex_init(&t->locks[i], NULL);
+    return t;
+}
+
+void free_tiled(TiledImage *t)
+{
+    if (!t)
+        return;
+    int n = t->nx * t->ny;
+    for (int i = 0; i < n; ++i)
+    {
+        free(t->tiles[i]);
+        pthread_mutex_destroy(&t->locks[i]);
+    }
+    if (t->loader_free)
+        t->loader_free(t->loader_ctx);
+    free(t->tiles);
+    free(t->locks);
+    free(t);
+}
+
+Rect tiled_tile_rect(const TiledImage *t, int tx, int ty)
+{
+    Rect r;
+    r.x = tx * t->tile;
+    r.y = ty * t->tile;
+    r.w = r.x + t->tile <= t->w ? t->tile : t->w - r.x;
+    r.h = r.y + t->tile <= t->h ? t->tile : t->h - r.y;
+    return r;
+}
+
+/** 取得 tile 緩衝區；尚未存在時用 loader 載入，沒有 loader 則配置全 0 的區塊 */
+unsigned char *tiled_tile(TiledImage *t, int tx, int ty)
+{
+    int i = ty * t->nx + tx;
+    pthread_mutex_lock(&t->locks[i]);
+    if (!t->tiles[i])
+    {
+        Rect r = tiled_tile_rect(t, tx, ty);
+        unsigned char *buf = (unsigned char *)calloc((size_t)r.w * r.h * t->c, 1);
+        if (t->loader && !t->loader(t->loader_ctx, &r, t->c, buf))
+            fprintf(stderr, "warning: failed to load tile (%d, %d)\n", tx, ty);
+        t->tiles[i] = buf;
+    }
+    unsigned char *p = t->tiles[i];
+    pthread_mutex_unlock(&t->locks[i]);
+    return p;
+}
+
+static int clip_rect(const TiledImage *t, const Rect *in, Rect *out)
+{
+    Rect r = in ? *in : (Rect){0, 0, t->w, t->h};
+    int x1 = r.x + r.w, y1 = r.y + r.h;
+    r.x = r.x < 0 ? 0 : r.x;
+    r.y = r.y < 0 ? 0 : r.y;
+    x1 = x1 > t->w ? t->w : x1;
+    y1 = y1 > t->h ? t->h : y1;
+    r.w = x1 - r.x;
+    r.h = y1 - r.y;
+    *out = r;
+    return r.w > 0 && r.h > 0;
+}
+
+int parse_rect(const char *spec, Rect *r)
+{
+    char tail;
+    if (sscanf(spec, "%dx%d+%d+%d%c", &r->w, &r->h, &r->x, &r->y, &tail) != 4)
+        return 0;
+    return r->w > 0 && r->h > 0 && r->x >= 0 && r->y >= 0;
+}
+
+Image *tiled_read_rect(TiledImage *t, const Rect *req)
+{
+    Rect r;
+    if (!clip_rect(t, req, &r))
+        return NULL;
+    Image *img = create_image(r.w, r.h, t->c);
+    int c = t->c;
+    for (int ty = r.y / t->tile; ty <= (r.y + r.h - 1) / t->tile; ++ty)
+    {
+        for (int tx = r.x / t->tile; tx <= (r.x + r.w - 1) / t->tile; ++tx)
+        {
+            Rect tr = tiled_tile_rect(t, tx, ty);
+            const unsigned char *src = tiled_tile(t, tx, ty);
+            int x0 = tr.x > r.x ? tr.x : r.x;
+            int x1 = tr.x + tr.w < r.x + r.w ? tr.x + tr.w : r.x + r.w;
+            int y0 = tr.y > r.y ? tr.y : r.y;
+            int y1 = tr.y + tr.h < r.y + r.h ? tr.y + tr.h : r.y + r.h;
+            for (int y = y0; y < y1; ++y)
+                memcpy(&img->data[((size_t)(y - r.y) * r.w + (x0 - r.x)) * c],
+                       &src[((size_t)(y - tr.y) * tr.w + (x0 - tr.x)) * c], (size_t)(x1 - x0) * c);
+        }
+    }
+    return img;
+}
+
+Image *tiled_to_image(TiledImage *t)
+{
+    return tiled_read_rect(t, NULL);
+}
+
+// ---------------- Loaders ----------------
+static int image_loader(void *ctx, const Rect *r, int c, unsigned char *dst)
+{
+    const Image *img = (const Image *)ctx;
+    for (int y = 0; y < r->h; ++y)
+        memcpy(&dst[(size_t)y * r->w * c], &img->data[((size_t)(r->y + y) * img->w + r->x) * c], (size_t)r->w * c);
+    return 1;
+}
+
+TiledImage *tiled_from_image(const Image *img, int tile)
+{
+    TiledImage *t = create_tiled(img->w, img->h, img->c, tile);
+    t->loader = image_loader;
+    t->loader_ctx = (void *)img;
+    return t;
+}
+
+static void image_source_free(void *ctx)
+{
+    free_image((Image *)ctx);
+}
+
+typedef struct
+{
+    int fd;
+    int w;
+    long offset;
+} RawSource;
+
+/** 從 RAW 檔逐列 pread 所需的區段（pread 不共用檔案位置，可多執行緒同時讀） */
+static int raw_loader(void *ctx, const Rect *r, int c, unsigned char *dst)
+{
+    const RawSource *src = (const RawSource *)ctx;
+    size_t n = (size_t)r->w * c;
+    for (int y = 0; y < r->h; ++y)
+    {
+        off_t off = src->offset + ((off_t)(r->y + y) * src->w + r->x) * c;
+        if (pread(src->fd, &dst[(size_t)y * n], n, off) != (ssize_t)n)
+            return 0;
+    }
+    return 1;
+}
+
+static void raw_source_free(void *ctx)
+{
+    RawSource *src = (RawSource *)ctx;
+    close(src->fd);
+    free(src);
+}
+
+TiledImage *tiled_open_raw(const char *path, const RawFormat *fmt, int tile)
+{
+    if (fmt->bits != 8 || fmt->w <= 0 || fmt->h <= 0 || fmt->c < 1)
+        return NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < fmt->offset + (off_t)fmt->w * fmt->h * fmt->c)
+    {
+        close(fd);
+        return NULL;
+    }
+    RawSource *src = (RawSource *)malloc(sizeof(RawSource));
+    src->fd = fd;
+    src->w = fmt->w;
+    src->offset = fmt->offset;
+    TiledImage *t = create_tiled(fmt->w, fmt->h, fmt->c, tile);
+    t->loader = raw_loader;
+    t->loader_ctx = src;
+    t->loader_free = raw_source_free;
+    return t;
+}
+
+/** BMP 的 tile 直接從 mmap 的像素列複製（翻轉與 BGR→RGB 在複製時完成） */
+static int bmp_loader(void *ctx, const Rect *r, int c, unsigned char *dst)
+{
+    (void)c;
+    view_read_rgb((const ImageView *)ctx, r->x, r->y, r->w, r->h, dst);
+    return 1;
+}
+
+static void bmp_source_free(void *ctx)
+{
+    bmp_close_view((ImageView *)ctx);
+    free(ctx);
+}
+
+TiledImage *tiled_open_bmp(const char *path, int tile)
+{
+    ImageView *v = (ImageView *)malloc(sizeof(ImageView));
+    if (!bmp_open_view(path, v))
+    {
+        free(v);
+        return NULL;
+    }
+    TiledImage *t = create_tiled(v->w, v->h, 3, tile);
+    t->loader = bmp_loader;
+    t->loader_ctx = v;
+    t->loader_free = bmp_source_free;
+    return t;
+}
+
+/** BMP 與 8-bit RAW 逐 tile 從檔案讀取；其他格式（PNG / JPG、16-bit RAW）只能整張解碼成 8-bit 再切 tile */
+TiledImage *tiled_open(const char *path, const RawFormat *hint, int tile)
+{
+    TiledImage *t = tiled_open_bmp(path, tile);
+    if (t)
+        return t;
+    ImageInfo info;
+    RawFormat fmt;
+    if (probe_image(path, &info) && info.raw && raw_detect(path, hint, &fmt) && fmt.bits == 8)
+        return tiled_open_raw(path, &fmt, tile);
+    Image *img = load_image_raw(path, hint);
+    if (!img)
+        return NULL;
+    t = tiled_from_image(img, tile);
+    t->loader_free = image_source_free;
+    return t;
+}
+
+// ---------------- Scheduler ----------------
+typedef struct
+{
+    TiledImage *t;
+    TileFn fn;
+    void *arg;
+    int tx0, ty0, nx;
+    atomic_int failed;
+} TileRun;
+
+/** 一個 band 是一段連續的 tile 編號（列優先） */
+static void tile_band(void *arg, int i0, int i1)
+{
+    TileRun *run = (TileRun *)arg;
+    for (int i = i0; i < i1; ++i)
+        if (!run->fn(run->t, run->tx0 + i % run->nx, run->ty0 + i / run->nx, run->arg))
+            atomic_store(&run->failed, 1);
+}
+
+/** 每個 tile 是預設排程器上的一個 band */
+int tiled_run(TiledImage *t, const Rect *roi, TileFn fn, void *arg)
+{
+    Rect r;
+    if (!clip_rect(t, roi, &r))
+        return 1;
+    TileRun run;
+    run.t = t;
+    run.fn = fn;
+    run.arg = arg;
+    run.tx0 = r.x / t->tile;
+    run.ty0 = r.y / t->tile;
+    run.nx = (r.x + r.w - 1) / t->tile - run.tx0 + 1;
+    atomic_init(&run.failed, 0);
+    int count = run.nx * ((r.y + r.h - 1) / t->tile - run.ty0 + 1);
+    sched_parallel_for(sched_default(), 0, count, 1, tile_band, &run);
+    return !atomic_load(&run.failed);
+}
+
+// ---------------- Tile operations ----------------
+typedef struct
+{
+    TiledImage *src;
+    PlaneOp op;
+    const void *arg;
+} PointTask;
+
+static int point_tile(TiledImage *dst, int tx, int ty, void *arg)
+{
+    PointTask *task = (PointTask *)arg;
+    Rect r = tiled_tile_rect(dst, tx, ty);
+    Image view = {r.w, r.h, dst->c, tiled_tile(task->src, tx, ty), PIXEL_U8};
+    Image *res = task->op(&view, task->arg);
+    if (!res || res->w != r.w || res->h != r.h || res->c != dst->c || res->type != PIXEL_U8)
+    {
+        free_image(res);
+        return 0;
+    }
+    memcpy(tiled_tile(dst, tx, ty), res->data, (size_t)r.w * r.h * dst->c);
+    free_image(res);
+    return 1;
+}
+
+TiledImage *tiled_point_op(TiledImage *src, PlaneOp op, const void *arg, const Rect *roi)
+{
+    TiledImage *dst = create_tiled(src->w, src->h, src->c, src->tile);
+    PointTask task = {src, op, arg};
+    if (!tiled_run(dst, roi, point_tile, &task))
+    {
+        free_tiled(dst);
+        return NULL;
+    }
+    return dst;
+}
+
+typedef struct
+{
+    TiledImage *src;
+    int bilinear;
+    int *x0, *x1, *y0, *y1; // 全圖座標下的來源索引
+    double *wx, *wy;
+} ResizeTask;
+
+/** 計算一個輸出 tile：只讀入它需要的來源範圍，索引表減去該範圍的原點後套用 row kernel */
+static int resize_tile(TiledImage *dst, int tx, int ty, void *arg)
+{
+    ResizeTask *task = (ResizeTask *)arg;
+    Rect r = tiled_tile_rect(dst, tx, ty);
+    const int *x1 = task->bilinear ? task->x1 : task->x0;
+    const int *y1 = task->bilinear ? task->y1 : task->y0;
+    Rect s;
+    s.x = task->x0[r.x];
+    s.y = task->y0[r.y];
+    s.w = x1[r.x + r.w - 1] - s.x + 1;
+    s.h = y1[r.y + r.h - 1] - s.y + 1;
+    Image *crop = tiled_read_rect(task->src, &s);
+    if (!crop)
+        return 0;
+
+    int c = dst->c;
+    int *lx0 = (int *)malloc(sizeof(int) * r.w * 2);
+    int *lx1 = lx0 + r.w;
+    for (int x = 0; x < r.w; ++x)
+    {
+        lx0[x] = task->x0[r.x + x] - s.x;
+        lx1[x] = x1[r.x + x] - s.x;
+    }
+    unsigned char *out = tiled_tile(dst, tx, ty);
+    size_t stride = (size_t)crop->w * c;
+    if (task->bilinear)
+    {
+        BilinearRowFn row = bilinear_row_fn(c);
+        for (int y = 0; y < r.h; ++y)
+            row(&crop->data[(task->y0[r.y + y] - s.y) * stride], &crop->data[(task->y1[r.y + y] - s.y) * stride],
+                &out[(size_t)y * r.w * c], r.w, c, lx0, lx1, &task->wx[r.x], task->wy[r.y + y]);
+    }
+    else
+    {
+        GatherRowFn gather = gather_row_fn(c);
+        for (int y = 0; y < r.h; ++y)
+            gather(&crop->data[(task->y0[r.y + y] - s.y) * stride], &out[(size_t)y * r.w * c], r.w, c, lx0);
+    }
+    free(lx0);
+    free_image(crop);
+    return 1;
+}
+
+TiledImage *tiled_resize(TiledImage *src, int out_w, int out_h, const char *method, const Rect *roi)
+{
+    ResizeTask task;
+    if (strcmp(method, "bilinear") == 0)
+        task.bilinear = 1;
+    else if (strcmp(method, "nearest") == 0)
+        task.bilinear = 0;
+    else
+        return NULL;
+
+    task.src = src;
+    task.x0 = (int *)malloc(sizeof(int) * (out_w + out_h) * 2);
+    task.x1 = task.x0 + out_w;
+    task.y0 = task.x1 + out_w;
+    task.y1 = task.y0 + out_h;
+    task.wx = (double *)malloc(sizeof(double) * (out_w + out_h));
+    task.wy = task.wx + out_w;
+    if (task.bilinear)
+    {
+        bilinear_axis_table(src->w, out_w, task.x0, task.x1, task.wx);
+        bilinear_axis_table(src->h, out_h, task.y0, task.y1, task.wy);
+    }
+    else
+    {
+        nearest_index_table(src->w, out_w, task.x0);
+        nearest_index_table(src->h, out_h, task.y0);
+    }
+
+    TiledImage *dst = create_tiled(out_w, out_h, src->c, src->tile);
+    if (!tiled_run(dst, roi, resize_tile, &task))
+    {
+        free_tiled(dst);
+        dst = NULL;
+    }
+    free(task.x0);
+    free(task.wx);
+    return dst;
+}
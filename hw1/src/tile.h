@@ -0,0 +1,60 @@
+#ifndef TILE_H
+#define TILE_H
+
+#include <pthread.h>
+#include "image.h"
+
+// Tiled image storage (tile.c). Tiles are allocated or loaded on first access,
+// so work restricted to an ROI only touches the tiles it overlaps.
+
+typedef struct
+{
+    int x, y, w, h;
+} Rect;
+
+// fill dst (r->w * r->h * c bytes, packed rows) with the pixels of r; 0 on failure
+typedef int (*TileLoader)(void *ctx, const Rect *r, int c, unsigned char *dst);
+
+typedef struct TiledImage
+{
+    int w, h, c;
+    int tile;   // tile edge length in pixels
+    int nx, ny; // tile grid size
+    unsigned char **tiles; // nx*ny, NULL until loaded / computed
+    pthread_mutex_t *locks;
+    TileLoader loader;
+    void *loader_ctx;
+    void (*loader_free)(void *ctx);
+} TiledImage;
+
+// per-tile callback for tiled_run; returns 0 on failure
+typedef int (*TileFn)(TiledImage *t, int tx, int ty, void *arg);
+
+#define TILE_DEFAULT 256
+
+TiledImage *create_tiled(int w, int h, int c, int tile);
+void free_tiled(TiledImage *t);
+TiledImage *tiled_from_image(const Image *img, int tile); // lazy: tiles are copied on demand
+TiledImage *tiled_open_raw(const char *path, const RawFormat *fmt, int tile); // 8-bit only; lazy reads with pread
+TiledImage *tiled_open_bmp(const char *path, int tile); // tiles copied from the mmapped file, RGB
+// BMP and 8-bit RAW (geometry as in load_image_raw) are read tile by tile; any
+// other file is decoded whole to 8-bit first. NULL if the file cannot be read
+TiledImage *tiled_open(const char *path, const RawFormat *hint, int tile);
+
+Rect tiled_tile_rect(const TiledImage *t, int tx, int ty);
+unsigned char *tiled_tile(TiledImage *t, int tx, int ty); // load or zero-allocate
+Image *tiled_read_rect(TiledImage *t, const Rect *r);     // crop (NULL = all), loading touched tiles; NULL if empty
+Image *tiled_to_image(TiledImage *t);
+int parse_rect(const char *spec, Rect *r); // "<w>x<h>+<x>+<y>"
+
+// run fn on every tile that intersects roi (NULL = whole image), one scheduler
+// band per tile (sched_default(); serial when there is none)
+int tiled_run(TiledImage *t, const Rect *roi, TileFn fn, void *arg);
+
+// tile-parallel operations; only tiles intersecting roi (in output coordinates)
+// are computed in the result, so a lazily opened source only loads what they read
+TiledImage *tiled_point_op(TiledImage *src, PlaneOp op, const void *arg, const Rect *roi);
+TiledImage *tiled_resize(TiledImage *src, int out_w, int out_h, const char *method,
+                         const Rect *roi); // nearest | bilinear
+
+#endif
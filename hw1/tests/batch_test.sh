@@ -0,0 +1,31 @@
+#!/bin/sh
+# Batch run with invalid jobs mixed in (make test-batch).
+# 參數錯誤的工作在讀檔前就結束：它們的輸入不能留在預讀清單裡佔著視窗，
+# 其餘工作的輸出仍要全部產生。
+set -u
+out=$(mktemp -d /tmp/batch_testXXXXXX)
+jobs="$out/jobs.txt"
+cat > "$jobs" <<JOBS
+point_op data/boat.bmp blur
+point_op data/lena.raw equalize planar
+point_op data/lena.raw
+resize data/baboon.bmp 512 512 64
+sharpen data/F16.bmp
+compare data/boat.bmp
+info data/peppers.raw
+point_op data/boat.bmp negative
+point_op data/lena.raw gamma 2.2
+resize data/baboon.bmp 512 512 128 128 bilinear
+stats data/F16.bmp
+JOBS
+
+log=$(./dip_tool --out "$out" batch "$jobs" 1 1 2>&1)
+status=0
+echo "$log" | grep -q ", 0 unclaimed)" || { echo "FAIL prefetched inputs left unclaimed"; status=1; }
+for f in B/boat_negative.png B/lena_gamma_2.20.png C/baboon_resize_512x512_to_128x128_bilinear.png; do
+    [ -s "$out/$f" ] || { echo "FAIL missing $f"; status=1; }
+done
+[ $status -eq 0 ] || echo "$log"
+rm -rf "$out"
+echo "batch_test: $([ $status -eq 0 ] && echo PASSED || echo FAILED)"
+exit $status
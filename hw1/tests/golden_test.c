@@ -0,0 +1,483 @@
+// Golden-image regression tests (make test).
+// 每個 kernel 在 data/ 的影像上執行，輸出與 tests/golden/ 中的參考影像比較（完全相同或
+// 不超過該 kernel 允許的最大絕對誤差），執行時間再與 tests/baseline.txt 的基準比較，
+// 超過 DIP_TEST_BUDGET 倍（預設 3）即視為效能退化。
+//   ./tests/golden_test             比較像素並檢查時間
+//   ./tests/golden_test --update    重新產生參考影像（確認新結果正確之後才用）
+//   ./tests/golden_test --baseline  以這台機器量到的時間重寫基準
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/image.h"
+#include "../src/hist.h"
+#include "../src/sched.h"
+#include "../src/tile.h"
+#include "../src/path.h"
+#include "../src/pipeline.h"
+
+#define GOLDEN_DIR "tests/golden"
+#define BASELINE "tests/baseline.txt"
+#define REPEAT 3         // 取最快的一次，減少雜訊
+#define SLACK_MS 2.0     // 很短的 kernel 容許的固定誤差
+#define TEST_TILE 96     // 不整除 data/ 的影像尺寸：邊緣有不完整的 tile
+
+typedef Image *(*KernelFn)(const Image *img, const char *arg);
+
+typedef struct
+{
+    const char *name;   // 參考影像的後綴，也是時間預算的單位
+    const char *golden; // 與哪個 kernel 的參考影像比較（layout 變體共用），NULL = 自己
+    PixelType type;     // 讀檔型別
+    int tol;            // 允許的最大絕對誤差（樣本單位）
+    KernelFn fn;        // NULL = 解碼本身
+    const char *arg;
+    const char *only;   // 只跑檔名以此開頭的輸入（NULL = 全部）
+} Kernel;
+
+static const char *kernel_input; // 目前的輸入檔（直接從檔案開 tile 的 kernel 用）
+
+static Image *k_point(const Image *img, const char *arg)
+{
+    char op[32];
+    double param = 1.0;
+    if (sscanf(arg, "%31s %lf", op, &param) < 1)
+        return NULL;
+    if (strcmp(op, "gamma_auto") == 0)
+        return point_auto_gamma(img, NULL);
+    return point_by_name(img, op, param);
+}
+
+/** 逐通道平面就地運算，再交錯回去（與 point_op ... planar 相同） */
+static Image *k_point_planar(const Image *img, const char *arg)
+{
+    char op[32];
+    double param = 1.0;
+    if (sscanf(arg, "%31s %lf", op, &param) < 1)
+        return NULL;
+    PlanarImage *p = to_planar(img);
+    Image *res = create_image_like(img);
+    int ok = 1;
+    for (int ch = 0; ok && ch < p->c; ++ch)
+    {
+        Image v = planar_view(p, ch);
+        ok = point_by_name_into(&v, &v, op, param);
+    }
+    ok = ok && from_planar_into(p, res);
+    free_planar(p);
+    return point_result(res, ok);
+}
+
+typedef struct
+{
+    int w, h;
+    char method[32];
+} ResizeArg;
+
+static int parse_resize(const char *arg, ResizeArg *r)
+{
+    return sscanf(arg, "%dx%d %31s", &r->w, &r->h, r->method) == 3;
+}
+
+static Image *k_resize(const Image *img, const char *arg)
+{
+    ResizeArg r;
+    return parse_resize(arg, &r) ? resize_by_name(img, r.w, r.h, r.method) : NULL;
+}
+
+static Image *resize_plane(const Image *plane, const void *arg)
+{
+    const ResizeArg *r = (const ResizeArg *)arg;
+    return resize_by_name(plane, r->w, r->h, r->method);
+}
+
+static Image *k_planar(const Image *img, const char *arg)
+{
+    ResizeArg r;
+    if (!parse_resize(arg, &r))
+        return NULL;
+    PlanarImage *src = to_planar(img);
+    PlanarImage *dst = planar_apply(src, resize_plane, &r, 1);
+    Image *res = dst ? from_planar(dst) : NULL;
+    free_planar(src);
+    free_planar(dst);
+    return res;
+}
+
+static Image *k_tiled(const Image *img, const char *arg)
+{
+    ResizeArg r;
+    if (!parse_resize(arg, &r))
+        return NULL;
+    TiledImage *src = tiled_from_image(img, TILE_DEFAULT);
+    TiledImage *dst = tiled_resize(src, r.w, r.h, r.method, NULL);
+    Image *res = dst ? tiled_to_image(dst) : NULL;
+    free_tiled(src);
+    free_tiled(dst);
+    return res;
+}
+
+/** tile 由 tiled_open 逐塊從檔案讀取（BMP / RAW），不先解碼整張 */
+static Image *k_tiled_lazy(const Image *img, const char *arg)
+{
+    (void)img;
+    ResizeArg r;
+    if (!parse_resize(arg, &r))
+        return NULL;
+    TiledImage *src = tiled_open(kernel_input, NULL, TEST_TILE);
+    TiledImage *dst = src ? tiled_resize(src, r.w, r.h, r.method, NULL) : NULL;
+    Image *res = dst ? tiled_to_image(dst) : NULL;
+    free_tiled(src);
+    free_tiled(dst);
+    return res;
+}
+
+typedef Image *(*RoiFn)(TiledImage *src, const Rect *roi, const char *arg);
+
+/** w x h 的結果切成四個不與 tile 對齊的 ROI 分別計算再拼回：每個像素都由某個 ROI 算出 */
+static Image *by_quadrants(TiledImage *src, int w, int h, RoiFn fn, const char *arg)
+{
+    int sx = w * 2 / 5, sy = h * 3 / 5;
+    const Rect q[4] = {{0, 0, sx, sy}, {sx, 0, w - sx, sy}, {0, sy, sx, h - sy}, {sx, sy, w - sx, h - sy}};
+    Image *out = NULL;
+    for (int i = 0; i < 4; ++i)
+    {
+        Image *part = fn(src, &q[i], arg);
+        if (!part || part->w != q[i].w || part->h != q[i].h)
+        {
+            free_image(part);
+            free_image(out);
+            return NULL;
+        }
+        if (!out)
+            out = create_image(w, h, part->c);
+        size_t row = (size_t)part->w * part->c;
+        for (int y = 0; y < part->h; ++y)
+            memcpy(&out->data[((size_t)(q[i].y + y) * w + q[i].x) * part->c], &part->data[y * row], row);
+        free_image(part);
+    }
+    return out;
+}
+
+static Image *point_tile(const Image *tile, const void *arg)
+{
+    return k_point(tile, (const char *)arg);
+}
+
+static Image *roi_point(TiledImage *src, const Rect *roi, const char *arg)
+{
+    TiledImage *dst = tiled_point_op(src, point_tile, arg, roi);
+    Image *res = dst ? tiled_read_rect(dst, roi) : NULL;
+    free_tiled(dst);
+    return res;
+}
+
+static Image *roi_resize(TiledImage *src, const Rect *roi, const char *arg)
+{
+    ResizeArg r;
+    if (!parse_resize(arg, &r))
+        return NULL;
+    TiledImage *dst = tiled_resize(src, r.w, r.h, r.method, roi);
+    Image *res = dst ? tiled_read_rect(dst, roi) : NULL;
+    free_tiled(dst);
+    return res;
+}
+
+/** 各 tile 平行的點運算（與 point_op ... tiled 相同） */
+static Image *k_point_tiled(const Image *img, const char *arg)
+{
+    TiledImage *src = tiled_from_image(img, TEST_TILE);
+    Image *res = roi_point(src, NULL, arg);
+    free_tiled(src);
+    return res;
+}
+
+static Image *k_resize_roi(const Image *img, const char *arg)
+{
+    ResizeArg r;
+    if (!parse_resize(arg, &r))
+        return NULL;
+    TiledImage *src = tiled_from_image(img, TEST_TILE);
+    Image *res = by_quadrants(src, r.w, r.h, roi_resize, arg);
+    free_tiled(src);
+    return res;
+}
+
+static int loaded_tiles(const TiledImage *t)
+{
+    int n = 0;
+    for (int i = 0; i < t->nx * t->ny; ++i)
+        n += t->tiles[i] != NULL;
+    return n;
+}
+
+/** 從檔案開 tile 後只算一個 ROI：來源只能載入與它重疊的 tile；再以四個 ROI 拼出整張比較 */
+static Image *k_point_lazy_roi(const Image *img, const char *arg)
+{
+    (void)img;
+    TiledImage *src = tiled_open(kernel_input, NULL, TEST_TILE);
+    if (!src)
+        return NULL;
+    Rect roi = {TEST_TILE + 10, 20, TEST_TILE, 30}; // 橫跨兩個 tile
+    Image *part = roi_point(src, &roi, arg);
+    int loaded = loaded_tiles(src);
+    free_image(part);
+    Image *res = NULL;
+    if (!part || loaded != 2)
+        printf("%s: ROI %dx%d+%d+%d loaded %d source tiles, want 2\n", kernel_input, roi.w, roi.h, roi.x, roi.y,
+               loaded);
+    else
+        res = by_quadrants(src, src->w, src->h, roi_point, arg);
+    free_tiled(src);
+    return res;
+}
+
+// 浮點曲線（log / pow、內插權重）在不同的 libm 或 FMA 設定下可能差 1，其餘必須完全相同
+static const Kernel kernels[] = {
+    {"read", NULL, PIXEL_U8, 0, NULL, NULL, NULL},
+    {"log", NULL, PIXEL_U8, 1, k_point, "log", NULL},
+    {"gamma_2.2", NULL, PIXEL_U8, 1, k_point, "gamma 2.2", NULL},
+    {"negative", NULL, PIXEL_U8, 0, k_point, "negative", NULL},
+    {"gamma_auto", NULL, PIXEL_U8, 1, k_point, "gamma_auto", NULL},
+    {"equalize", NULL, PIXEL_U8, 1, k_point, "equalize", NULL},
+    {"stretch_1", NULL, PIXEL_U8, 1, k_point, "stretch 1", NULL},
+    {"clahe_2", NULL, PIXEL_U8, 1, k_point, "clahe 2", NULL},
+    {"gamma_2.2_u16", NULL, PIXEL_U16, 1, k_point, "gamma 2.2", "lena"},
+    {"nearest_128", NULL, PIXEL_U8, 0, k_resize, "128x128 nearest", NULL},
+    {"bilinear_128", NULL, PIXEL_U8, 1, k_resize, "128x128 bilinear", NULL},
+    {"area_128", NULL, PIXEL_U8, 0, k_resize, "128x128 area", NULL},
+    {"area_200x300", NULL, PIXEL_U8, 1, k_resize, "200x300 area", NULL},
+    {"bicubic_128", NULL, PIXEL_U8, 1, k_resize, "128x128 bicubic", NULL},
+    {"lanczos3_128", NULL, PIXEL_U8, 1, k_resize, "128x128 lanczos3", NULL},
+    {"mitchell_128", NULL, PIXEL_U8, 1, k_resize, "128x128 mitchell", NULL},
+    {"nearest_1024x512", NULL, PIXEL_U8, 0, k_resize, "1024x512 nearest", "F16"},
+    {"bilinear_1024x512", NULL, PIXEL_U8, 1, k_resize, "1024x512 bilinear", "F16"},
+    {"gamma_planar", "gamma_2.2", PIXEL_U8, 1, k_point_planar, "gamma 2.2", NULL},
+    {"bicubic_planar", "bicubic_128", PIXEL_U8, 1, k_planar, "128x128 bicubic", NULL},
+    {"bilinear_tiled", "bilinear_128", PIXEL_U8, 1, k_tiled, "128x128 bilinear", NULL},
+    {"nearest_tiled", "nearest_128", PIXEL_U8, 0, k_tiled, "128x128 nearest", NULL},
+    {"bilinear_lazy", "bilinear_128", PIXEL_U8, 1, k_tiled_lazy, "128x128 bilinear", NULL},
+    {"bilinear_roi", "bilinear_1024x512", PIXEL_U8, 1, k_resize_roi, "1024x512 bilinear", "F16"},
+    {"negative_tiled", "negative", PIXEL_U8, 0, k_point_tiled, "negative", NULL},
+    {"gamma_lazy_roi", "gamma_2.2", PIXEL_U8, 1, k_point_lazy_roi, "gamma 2.2", NULL},
+};
+#define NKERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static void golden_path(char *buf, size_t n, const char *input, const char *name)
+{
+    char stem[256];
+    path_stem(input, stem, sizeof(stem));
+    snprintf(buf, n, "%s/%s_%s.png", GOLDEN_DIR, stem, name);
+}
+
+/** 每個像素三個通道都相同（灰階的 BMP）時存成單通道，參考影像小三分之二 */
+static int all_gray(const Image *img)
+{
+    if (img->c != 3 || img->type != PIXEL_U8)
+        return 0;
+    for (size_t i = 0; i < (size_t)img->w * img->h; ++i)
+    {
+        const unsigned char *p = &img->data[i * 3];
+        if (p[0] != p[1] || p[1] != p[2])
+            return 0;
+    }
+    return 1;
+}
+
+static void write_golden(const char *path, const Image *img)
+{
+    if (!all_gray(img))
+    {
+        save_png(path, img);
+        return;
+    }
+    Image *g = create_image(img->w, img->h, 1);
+    for (size_t i = 0; i < (size_t)img->w * img->h; ++i)
+        g->data[i] = img->data[i * 3];
+    save_png(path, g);
+    free_image(g);
+}
+
+static double sample_at(const Image *img, size_t i)
+{
+    if (img->type == PIXEL_U16)
+        return ((const unsigned short *)img->data)[i];
+    if (img->type == PIXEL_F32)
+        return ((const float *)img->data)[i];
+    return img->data[i];
+}
+
+/** 最大絕對誤差；單通道的參考影像對應到輸出的每個通道。尺寸不符回傳 -1 */
+static double max_abs_diff(const Image *out, const Image *ref)
+{
+    if (out->w != ref->w || out->h != ref->h || (ref->c != out->c && ref->c != 1))
+        return -1;
+    double worst = 0;
+    for (size_t p = 0; p < (size_t)out->w * out->h; ++p)
+    {
+        for (int k = 0; k < out->c; ++k)
+        {
+            double d = sample_at(out, p * out->c + k) - sample_at(ref, p * ref->c + (ref->c == 1 ? 0 : k));
+            if (d < 0)
+                d = -d;
+            if (d > worst)
+                worst = d;
+        }
+    }
+    return worst;
+}
+
+static int load_baseline(double *ms)
+{
+    FILE *fp = fopen(BASELINE, "r");
+    if (!fp)
+        return 0;
+    char name[64];
+    double v;
+    while (fscanf(fp, "%63s %lf", name, &v) == 2)
+        for (int k = 0; k < NKERNELS; ++k)
+            if (strcmp(name, kernels[k].name) == 0)
+                ms[k] = v;
+    fclose(fp);
+    return 1;
+}
+
+static void save_baseline(const double *ms)
+{
+    FILE *fp = fopen(BASELINE, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "cannot write %s\n", BASELINE);
+        return;
+    }
+    for (int k = 0; k < NKERNELS; ++k)
+        fprintf(fp, "%s %.3f\n", kernels[k].name, ms[k]);
+    fclose(fp);
+}
+
+/** 解碼或執行 kernel，重複 REPEAT 次取最短時間；回傳最後一次的結果 */
+static Image *run_timed(const Kernel *k, const char *input, double *ms)
+{
+    kernel_input = input;
+    Image *src = k->fn ? load_image_as(input, NULL, k->type) : NULL;
+    if (k->fn && !src)
+        return NULL;
+    Image *res = NULL;
+    double best = 0;
+    for (int r = 0; r < REPEAT; ++r)
+    {
+        free_image(res);
+        double t0 = now_ms();
+        res = k->fn ? k->fn(src, k->arg) : load_image_as(input, NULL, k->type);
+        double t = now_ms() - t0;
+        if (r == 0 || t < best)
+            best = t;
+    }
+    free_image(src);
+    *ms = best;
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    int update = argc > 1 && strcmp(argv[1], "--update") == 0;
+    int rebase = argc > 1 && strcmp(argv[1], "--baseline") == 0;
+    const char *budget_env = getenv("DIP_TEST_BUDGET");
+    double budget = budget_env ? atof(budget_env) : 3.0;
+
+    Scheduler *sched = sched_create(0);
+    sched_set_default(sched);
+    set_verbose(0);
+    if (update && ensure_dir(GOLDEN_DIR) != 0)
+    {
+        fprintf(stderr, "cannot create %s\n", GOLDEN_DIR);
+        return 1;
+    }
+
+    char **inputs = NULL;
+    int n = collect_inputs("data", &inputs);
+    if (n <= 0)
+    {
+        fprintf(stderr, "no inputs in data/\n");
+        return 1;
+    }
+
+    double ms[NKERNELS] = {0}, base[NKERNELS] = {0};
+    int have_base = !update && !rebase && load_baseline(base);
+    int failures = 0;
+    printf("%-20s %5s %9s %10s %11s\n", "kernel", "cases", "max err", "time ms", "baseline ms");
+    for (int k = 0; k < NKERNELS; ++k)
+    {
+        const Kernel *kn = &kernels[k];
+        int cases = 0, bad = 0;
+        double worst = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            char stem[256];
+            path_stem(inputs[i], stem, sizeof(stem));
+            if (kn->only && strncmp(stem, kn->only, strlen(kn->only)) != 0)
+                continue;
+            double t = 0;
+            Image *out = run_timed(kn, inputs[i], &t);
+            ms[k] += t;
+            cases++;
+            char gp[OUT_PATH_MAX];
+            golden_path(gp, sizeof(gp), inputs[i], kn->golden ? kn->golden : kn->name);
+            if (!out)
+            {
+                printf("FAIL %s on %s: no output\n", kn->name, inputs[i]);
+                bad++;
+                continue;
+            }
+            if (update)
+            {
+                if (!kn->golden)
+                    write_golden(gp, out);
+                free_image(out);
+                continue;
+            }
+            Image *ref = read_image_as(gp, out->type == PIXEL_U8 ? PIXEL_U8 : PIXEL_U16);
+            double d = ref ? max_abs_diff(out, ref) : -1;
+            if (d < 0 || d > kn->tol)
+            {
+                if (d < 0)
+                    printf("FAIL %s on %s: missing or mismatched %s\n", kn->name, inputs[i], gp);
+                else
+                    printf("FAIL %s on %s: max error %.0f > %d\n", kn->name, inputs[i], d, kn->tol);
+                bad++;
+            }
+            if (d > worst)
+                worst = d;
+            free_image(ref);
+            free_image(out);
+        }
+        int slow = have_base && base[k] > 0 && ms[k] > base[k] * budget + SLACK_MS;
+        printf("%-20s %5d %5.0f/%-3d %10.2f", kn->name, cases, worst, kn->tol, ms[k]);
+        if (have_base && base[k] > 0)
+            printf(" %11.2f%s", base[k], slow ? "  SLOW" : "");
+        printf("%s\n", bad ? "  FAIL" : "");
+        failures += bad + slow;
+    }
+    free_inputs(inputs, n);
+    sched_destroy(sched);
+
+    if (update || rebase)
+    {
+        save_baseline(ms);
+        printf("%s%s updated\n", update ? GOLDEN_DIR " and " : "", BASELINE);
+        return 0;
+    }
+    if (!have_base)
+        printf("no %s: time budgets not checked (make test-baseline)\n", BASELINE);
+    printf("%s (%d failures, time budget %.1fx baseline)\n", failures ? "FAILED" : "PASSED", failures, budget);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+// Stress test for path.c (make test).
+// 多個執行緒同時呼叫 out_path / path_stem / ensure_dir，結果與單純 snprintf 的預期值比較，
+// 並檢查 buffer 太小與路徑超過 OUT_PATH_MAX 時的截斷與回傳長度。
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../src/path.h"
+
+#define THREADS 8
+#define ITERS 20000
+
+static char tmp_root[64];
+static int failures;
+static pthread_mutex_t fail_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void fail(const char *what, const char *got, const char *want)
+{
+    pthread_mutex_lock(&fail_lock);
+    if (failures++ < 10)
+        fprintf(stderr, "FAIL %s: got \"%s\", want \"%s\"\n", what, got, want);
+    pthread_mutex_unlock(&fail_lock);
+}
+
+/** 超過 OUT_PATH_MAX 的路徑：回傳值必須 >= buffer 大小（呼叫端據此放棄存檔），內容是完整路徑的前綴 */
+static void long_paths(int id)
+{
+    size_t stem_len = OUT_PATH_MAX + 100 * id;
+    char *src = (char *)malloc(stem_len + 16), *want = (char *)malloc(stem_len + 64);
+    char got[OUT_PATH_MAX];
+    strcpy(src, "data/");
+    memset(src + 5, 'a' + id % 26, stem_len);
+    strcpy(src + 5 + stem_len, ".raw");
+    int len = snprintf(want, stem_len + 64, "%s/C/%.*s_x.png", out_root(), (int)stem_len, src + 5);
+    size_t n = out_path(got, sizeof(got), "C", src, "_x");
+    if (n != (size_t)len || n < sizeof(got) || strncmp(got, want, sizeof(got) - 1) != 0 ||
+        got[sizeof(got) - 1] != '\0')
+        fail("out_path longer than OUT_PATH_MAX", got, want);
+    free(src);
+    free(want);
+}
+
+/** 每個執行緒產生不同的檔名與後綴，互相干擾時結果就會混在一起 */
+static void *worker(void *arg)
+{
+    int id = (int)(long)arg;
+    char src[128], stem[64], want[OUT_PATH_MAX], got[OUT_PATH_MAX], small[24];
+    for (int i = 0; i < ITERS; ++i)
+    {
+        snprintf(stem, sizeof(stem), "img%d_%d", id, i);
+        snprintf(src, sizeof(src), "data/dir.%d/%s.raw", i % 7, stem);
+
+        char s[64];
+        size_t n = path_stem(src, s, sizeof(s));
+        if (n != strlen(stem) || strcmp(s, stem) != 0)
+            fail("path_stem", s, stem);
+
+        double g = 0.1 * (i % 50);
+        int len = snprintf(want, sizeof(want), "%s/t%d/%s_gamma_%.2f.png", out_root(), id, stem, g);
+        char sub[16];
+        snprintf(sub, sizeof(sub), "t%d", id);
+        n = out_path(got, sizeof(got), sub, src, "_gamma_%.2f", g);
+        if (n != (size_t)len || strcmp(got, want) != 0)
+            fail("out_path", got, want);
+
+        // 截斷：內容是預期值的前綴，回傳值仍是完整長度
+        size_t cap = 1 + (size_t)(i % (int)sizeof(small));
+        n = out_path(small, cap, sub, src, "_gamma_%.2f", g);
+        if (n != (size_t)len || strncmp(small, want, cap - 1) != 0 || small[cap - 1] != '\0')
+            fail("out_path truncated", small, want);
+
+        if (i % 1000 == 0)
+            long_paths(id);
+        if (i % 500 == 0)
+        {
+            char dir[128];
+            snprintf(dir, sizeof(dir), "%s/d%d/e%d", tmp_root, i % 4, (i / 500) % 3);
+            struct stat sb;
+            if (ensure_dir(dir) != 0 || stat(dir, &sb) != 0 || !S_ISDIR(sb.st_mode))
+                fail("ensure_dir", dir, "a directory");
+        }
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    strcpy(tmp_root, "/tmp/path_stressXXXXXX");
+    if (!mkdtemp(tmp_root))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    set_out_root("out");
+
+    char s[8];
+    if (path_stem("a/b.c/name", s, sizeof(s)) != 4 || strcmp(s, "name") != 0)
+        fail("path_stem no extension", s, "name");
+    if (path_stem("averyveryverylongname.bmp", s, sizeof(s)) != 21 || strcmp(s, "averyve") != 0)
+        fail("path_stem truncated", s, "averyve");
+    if (path_stem("x.png", NULL, 0) != 1)
+        fail("path_stem n = 0", "", "1");
+
+    pthread_t th[THREADS];
+    for (long t = 0; t < THREADS; ++t)
+        pthread_create(&th[t], NULL, worker, (void *)t);
+    for (int t = 0; t < THREADS; ++t)
+        pthread_join(th[t], NULL);
+
+    char cmd[96];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", tmp_root);
+    if (system(cmd) != 0)
+        fprintf(stderr, "warning: could not remove %s\n", tmp_root);
+
+    printf("path_stress: %d threads x %d iterations, %s\n", THREADS, ITERS, failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}